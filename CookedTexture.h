@@ -0,0 +1,396 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Mipmap.h"
+#include "stb_image.h"
+
+// "Cooked" texture arrays: an offline step (spg --cook) decodes the source
+// images once, pads them to a common layer size, builds the full mip chain
+// and compresses it to BC1 (BC3 if any texel is translucent), or keeps raw
+// RGBA8. The result is a single file laid out so that each mip level of all
+// layers is one contiguous block, which the runtime maps with mmap and hands
+// to glCompressedTexSubImage3D without any decode or copy on our side.
+//
+// File layout (little endian):
+//   Header
+//   float  scale[layers][2]   UV scale of each padded layer
+//   Level  level[levels]
+//   level data, 16-byte aligned
+class CookedTexture {
+  public:
+    enum Format : uint32_t { RGBA8 = 0, BC1 = 1, BC3 = 2 };
+
+    struct Header {
+        char magic[4]; // "STEX"
+        uint32_t version;
+        uint32_t format;
+        uint32_t width, height, layers, levels;
+        uint32_t reserved;
+    };
+
+    struct Level {
+        uint64_t offset; // from the start of the file
+        uint64_t size;   // bytes for all layers
+        uint32_t width, height;
+    };
+
+    // 2: mip colours are averaged in linear light (Mipmap.h)
+    static constexpr uint32_t fileVersion = 2;
+
+  private:
+    int fd;
+    void *mapping;
+    size_t mappingSize;
+    const Header *header;
+    const float *scales;
+    const Level *levelTable;
+
+    // ---- cooking ------------------------------------------------------
+
+    struct Image {
+        int width, height;
+        std::vector<unsigned char> rgba;
+
+        const unsigned char *at(int x, int y) const {
+            x = std::min(x, width - 1);
+            y = std::min(y, height - 1);
+            return &rgba[((size_t)y * width + x) * 4];
+        }
+    };
+
+    // Same filter as the loader's mips, so cooked and streamed materials match
+    static Image halve(const Image &src) {
+        Image dst;
+        dst.width = std::max(1, src.width / 2);
+        dst.height = std::max(1, src.height / 2);
+        dst.rgba.resize((size_t)dst.width * dst.height * 4);
+        Mipmap::halve(src.rgba.data(), src.width, src.height, dst.rgba.data());
+        return dst;
+    }
+
+    static uint16_t to565(const int *c) {
+        return (uint16_t)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 |
+                          ((c[2] * 31 + 127) / 255));
+    }
+
+    static void from565(uint16_t v, int *c) {
+        c[0] = ((v >> 11) & 31) * 255 / 31;
+        c[1] = ((v >> 5) & 63) * 255 / 63;
+        c[2] = (v & 31) * 255 / 31;
+    }
+
+    // BC1 colour block: endpoints are the two texels furthest apart along
+    // the block's bounding-box diagonal, always in four-colour mode.
+    static void encodeColor(const unsigned char block[16][4], unsigned char *out) {
+        int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+            for (int c = 0; c < 3; c++) {
+                lo[c] = std::min(lo[c], (int)block[i][c]);
+                hi[c] = std::max(hi[c], (int)block[i][c]);
+            }
+        int axis[3] = {hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2]};
+        int minDot = INT32_MAX, maxDot = INT32_MIN, minIdx = 0, maxIdx = 0;
+        for (int i = 0; i < 16; i++) {
+            int d = block[i][0] * axis[0] + block[i][1] * axis[1] + block[i][2] * axis[2];
+            if (d < minDot) {
+                minDot = d;
+                minIdx = i;
+            }
+            if (d > maxDot) {
+                maxDot = d;
+                maxIdx = i;
+            }
+        }
+        int c0[3] = {block[maxIdx][0], block[maxIdx][1], block[maxIdx][2]};
+        int c1[3] = {block[minIdx][0], block[minIdx][1], block[minIdx][2]};
+        uint16_t e0 = to565(c0), e1 = to565(c1);
+        if (e0 < e1)
+            std::swap(e0, e1);
+
+        uint32_t indices = 0;
+        if (e0 != e1) {
+            int palette[4][3];
+            from565(e0, palette[0]);
+            from565(e1, palette[1]);
+            for (int c = 0; c < 3; c++) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            for (int i = 0; i < 16; i++) {
+                int best = 0, bestError = INT32_MAX;
+                for (int p = 0; p < 4; p++) {
+                    int error = 0;
+                    for (int c = 0; c < 3; c++) {
+                        int d = block[i][c] - palette[p][c];
+                        error += d * d;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        best = p;
+                    }
+                }
+                indices |= (uint32_t)best << (2 * i);
+            }
+        }
+        out[0] = e0 & 0xff;
+        out[1] = e0 >> 8;
+        out[2] = e1 & 0xff;
+        out[3] = e1 >> 8;
+        memcpy(out + 4, &indices, 4);
+    }
+
+    // BC3 alpha block in eight-value mode (a0 > a1).
+    static void encodeAlpha(const unsigned char block[16][4], unsigned char *out) {
+        int a0 = 0, a1 = 255;
+        for (int i = 0; i < 16; i++) {
+            a0 = std::max(a0, (int)block[i][3]);
+            a1 = std::min(a1, (int)block[i][3]);
+        }
+        uint64_t bits = 0;
+        if (a0 != a1) {
+            int palette[8] = {a0, a1};
+            for (int p = 1; p < 7; p++)
+                palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+            for (int i = 0; i < 16; i++) {
+                int best = 0;
+                for (int p = 1; p < 8; p++)
+                    if (std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[best]))
+                        best = p;
+                bits |= (uint64_t)best << (3 * i);
+            }
+        }
+        out[0] = (unsigned char)a0;
+        out[1] = (unsigned char)a1;
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (unsigned char)(bits >> (8 * i));
+    }
+
+    static void encode(const Image &image, Format format, std::vector<unsigned char> &out) {
+        if (format == RGBA8) {
+            out.insert(out.end(), image.rgba.begin(), image.rgba.end());
+            return;
+        }
+        int blockBytes = format == BC1 ? 8 : 16;
+        for (int by = 0; by < image.height; by += 4)
+            for (int bx = 0; bx < image.width; bx += 4) {
+                unsigned char block[16][4];
+                for (int i = 0; i < 16; i++)
+                    memcpy(block[i], image.at(bx + i % 4, by + i / 4), 4);
+                size_t at = out.size();
+                out.resize(at + blockBytes);
+                if (format == BC3) {
+                    encodeAlpha(block, &out[at]);
+                    encodeColor(block, &out[at + 8]);
+                } else
+                    encodeColor(block, &out[at]);
+            }
+    }
+
+  public:
+    CookedTexture()
+        : fd(-1), mapping(NULL), mappingSize(0), header(NULL), scales(NULL), levelTable(NULL) {}
+    ~CookedTexture() { close(); }
+    CookedTexture(const CookedTexture &) = delete;
+    CookedTexture &operator=(const CookedTexture &) = delete;
+
+    // Cooks the images into one texture array file. Returns false if any
+    // image cannot be decoded or the file cannot be written.
+    static bool cook(const std::vector<std::string> &sources, const std::string &destination, bool compress) {
+        std::vector<Image> layers;
+        int width = 0, height = 0;
+        bool translucent = false;
+        for (auto &path : sources) {
+            Image image;
+            int nrChannels;
+            unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &nrChannels, 4);
+            if (!data) {
+                std::cout << "Failed to load texture " << path << std::endl;
+                return false;
+            }
+            image.rgba.assign(data, data + (size_t)image.width * image.height * 4);
+            stbi_image_free(data);
+            for (size_t i = 3; i < image.rgba.size() && !translucent; i += 4)
+                translucent = image.rgba[i] < 255;
+            width = std::max(width, image.width);
+            height = std::max(height, image.height);
+            layers.push_back(std::move(image));
+        }
+        if (layers.empty())
+            return false;
+
+        Header header = {{'S', 'T', 'E', 'X'}, fileVersion, RGBA8, (uint32_t)width, (uint32_t)height,
+                         (uint32_t)layers.size(), 1, 0};
+        if (compress)
+            header.format = translucent ? BC3 : BC1;
+        while ((std::max(width, height) >> header.levels) > 0)
+            header.levels++;
+
+        // Pad every layer to width x height by repeating the last row/column
+        std::vector<float> scales;
+        for (auto &image : layers) {
+            scales.push_back((float)image.width / width);
+            scales.push_back((float)image.height / height);
+            Image padded;
+            padded.width = width;
+            padded.height = height;
+            padded.rgba.resize((size_t)width * height * 4);
+            for (int y = 0; y < height; y++)
+                for (int x = 0; x < width; x++)
+                    memcpy(&padded.rgba[((size_t)y * width + x) * 4], image.at(x, y), 4);
+            image = std::move(padded);
+        }
+
+        size_t tableEnd = sizeof(Header) + scales.size() * sizeof(float) + header.levels * sizeof(Level);
+        std::vector<Level> levels(header.levels);
+        std::vector<unsigned char> data;
+        uint64_t offset = (tableEnd + 15) & ~(uint64_t)15;
+        for (uint32_t level = 0; level < header.levels; level++) {
+            std::vector<unsigned char> block;
+            for (auto &image : layers)
+                encode(image, (Format)header.format, block);
+            levels[level] = {offset, block.size(), (uint32_t)layers[0].width, (uint32_t)layers[0].height};
+            data.insert(data.end(), block.begin(), block.end());
+            data.resize((data.size() + 15) & ~(size_t)15);
+            offset = ((tableEnd + 15) & ~(uint64_t)15) + data.size();
+            if (level + 1 < header.levels)
+                for (auto &image : layers)
+                    image = halve(image);
+        }
+
+        std::ofstream file(destination, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)scales.data(), scales.size() * sizeof(float));
+        file.write((const char *)levels.data(), levels.size() * sizeof(Level));
+        std::vector<char> padding(((tableEnd + 15) & ~(size_t)15) - tableEnd, 0);
+        file.write(padding.data(), padding.size());
+        file.write((const char *)data.data(), data.size());
+        if (!file) {
+            std::cout << "Failed to write " << destination << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // True if destination exists and is newer than every source.
+    static bool upToDate(const std::vector<std::string> &sources, const std::string &destination) {
+        std::error_code ec;
+        auto cooked = std::filesystem::last_write_time(destination, ec);
+        if (ec)
+            return false;
+        for (auto &path : sources) {
+            auto source = std::filesystem::last_write_time(path, ec);
+            if (ec || source > cooked)
+                return false;
+        }
+        return true;
+    }
+
+    // Maps a cooked file and validates its tables.
+    bool open(const std::string &path) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+            close();
+            return false;
+        }
+        mappingSize = st.st_size;
+        mapping = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = NULL;
+            close();
+            return false;
+        }
+
+        header = (const Header *)mapping;
+        const Header &h = *header;
+        uint32_t maxLevels = 1;
+        while (std::max(h.width, h.height) >> maxLevels)
+            maxLevels++;
+        size_t tableEnd = sizeof(Header) + (size_t)h.layers * 2 * sizeof(float) + (size_t)h.levels * sizeof(Level);
+        bool valid = memcmp(h.magic, "STEX", 4) == 0 && h.version == fileVersion && h.format <= BC3 &&
+                     h.width > 0 && h.height > 0 && h.layers > 0 && h.levels > 0 && h.levels <= maxLevels &&
+                     tableEnd <= mappingSize;
+        if (valid) {
+            scales = (const float *)(header + 1);
+            levelTable = (const Level *)(scales + h.layers * 2);
+            // upload() hands each level to GL with only its size, so every
+            // level must hold exactly the bytes its format and size need
+            for (uint32_t i = 0; i < h.levels && valid; i++) {
+                const Level &l = levelTable[i];
+                uint64_t w = std::max(1u, h.width >> i), hh = std::max(1u, h.height >> i);
+                uint64_t bytes = h.format == RGBA8 ? w * hh * 4
+                                                   : ((w + 3) / 4) * ((hh + 3) / 4) * (h.format == BC1 ? 8 : 16);
+                valid = l.width == w && l.height == hh && l.size == bytes * h.layers && l.offset <= mappingSize &&
+                        l.size <= mappingSize - l.offset;
+            }
+        }
+        if (!valid) {
+            std::cout << "Invalid cooked texture " << path << std::endl;
+            close();
+        }
+        return valid;
+    }
+
+    void close() {
+        if (mapping)
+            munmap(mapping, mappingSize);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+        mapping = NULL;
+        header = NULL;
+    }
+
+    const Header &info() const { return *header; }
+    const Level &level(int i) const { return levelTable[i]; }
+    const void *levelData(int i) const { return (const char *)mapping + levelTable[i].offset; }
+    float scaleX(int layer) const { return scales[layer * 2]; }
+    float scaleY(int layer) const { return scales[layer * 2 + 1]; }
+
+    GLenum internalFormat() const {
+        switch (header->format) {
+        case BC1:
+            return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BC3:
+            return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        default:
+            return GL_RGBA8;
+        }
+    }
+
+    // Whether the current context can sample this file's format.
+    bool supported() const { return header->format == RGBA8 || GLEW_EXT_texture_compression_s3tc; }
+
+    // Allocates the bound GL_TEXTURE_2D_ARRAY and uploads every level
+    // straight from the mapping.
+    void upload() const {
+        const Header &h = *header;
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, h.levels, internalFormat(), h.width, h.height, h.layers);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (uint32_t i = 0; i < h.levels; i++) {
+            const Level &l = levelTable[i];
+            if (h.format == RGBA8)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, 0, l.width, l.height, h.layers, GL_RGBA,
+                                GL_UNSIGNED_BYTE, levelData(i));
+            else
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, 0, l.width, l.height, h.layers,
+                                          internalFormat(), (GLsizei)l.size, levelData(i));
+        }
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Per-frame instrumentation: a ring buffer of frame times (min / avg / p99),
+// CPU and GPU timings of named sections, draw call and state change
+// counters, and an export of everything as a Chrome trace
+// (chrome://tracing or https://ui.perfetto.dev).
+//
+// GPU sections are bracketed by GL_TIMESTAMP queries, which may nest, and
+// are read back FRAME_LAG frames later so the CPU never waits on the GPU.
+class FrameStats {
+    typedef std::chrono::steady_clock Clock;
+
+    static const int HISTORY = 240;     // frames kept for min/avg/p99
+    static const int FRAME_LAG = 4;     // frames before GPU queries are read
+    static const int MAX_SECTIONS = 16; // GPU sections per frame
+    static const size_t MAX_EVENTS = 1 << 20;
+
+    struct Event {
+        const char *name;
+        char phase;   // 'X' complete event, 'C' counter
+        int tid;      // 1 = CPU, 2 = GPU
+        double ts;    // microseconds since start
+        double dur;   // microseconds, or first counter value
+        double value; // second counter value
+    };
+
+    struct GpuSection {
+        const char *name;
+        GLuint begin, end;
+    };
+
+    struct GpuFrame {
+        GpuSection sections[MAX_SECTIONS];
+        int count;
+    };
+
+    struct OpenSection {
+        const char *name;
+        double start;
+        int gpu; // index in the current GpuFrame, -1 if not timed on the GPU
+    };
+
+    Clock::time_point start, frameStart;
+    double gpuOffset; // CPU microseconds minus GPU microseconds
+    bool gpuTimers;
+
+    double times[HISTORY];
+    int count, head;
+    int frameIndex;
+
+    int drawCalls, stateChanges;
+    int lastDrawCalls, lastStateChanges;
+    double lastGpuFrame; // ms of the most recently resolved "frame" GPU section
+
+    GpuFrame gpuFrames[FRAME_LAG];
+    std::vector<OpenSection> open;
+    std::vector<Event> events;
+
+    double now() const { return std::chrono::duration<double, std::micro>(Clock::now() - start).count(); }
+
+    void record(const Event &e) {
+        if (events.size() < MAX_EVENTS)
+            events.push_back(e);
+    }
+
+    // Reads back the queries issued FRAME_LAG frames ago.
+    void resolveGpu(GpuFrame &frame) {
+        for (int i = 0; i < frame.count; i++) {
+            GpuSection &s = frame.sections[i];
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(s.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(s.end, GL_QUERY_RESULT, &end);
+            double dur = (end - begin) / 1000.0;
+            record({s.name, 'X', 2, begin / 1000.0 + gpuOffset, dur, 0});
+            if (i == 0)
+                lastGpuFrame = dur / 1000.0;
+        }
+        frame.count = 0;
+    }
+
+  public:
+    FrameStats()
+        : gpuOffset(0), gpuTimers(false), count(0), head(0), frameIndex(0), drawCalls(0), stateChanges(0),
+          lastDrawCalls(0), lastStateChanges(0), lastGpuFrame(0) {
+        start = frameStart = Clock::now();
+        for (auto &f : gpuFrames)
+            f.count = 0;
+    }
+
+    // Creates the timer queries; needs a current context.
+    void init() {
+        GLint bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        gpuTimers = bits > 0;
+        if (gpuTimers) {
+            for (auto &f : gpuFrames)
+                for (auto &s : f.sections) {
+                    glGenQueries(1, &s.begin);
+                    glGenQueries(1, &s.end);
+                }
+            GLint64 gpuNow = 0;
+            glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+            gpuOffset = now() - gpuNow / 1000.0;
+        }
+        start = frameStart = Clock::now();
+    }
+
+    void beginFrame() {
+        frameStart = Clock::now();
+        drawCalls = stateChanges = 0;
+        if (gpuTimers)
+            resolveGpu(gpuFrames[frameIndex % FRAME_LAG]);
+        begin("frame");
+    }
+
+    void endFrame() {
+        end();
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        times[head] = ms;
+        head = (head + 1) % HISTORY;
+        count = std::min(count + 1, HISTORY);
+        lastDrawCalls = drawCalls;
+        lastStateChanges = stateChanges;
+        record({"draw calls / state changes", 'C', 1, now(), (double)drawCalls, (double)stateChanges});
+        frameIndex++;
+    }
+
+    // Named section, timed on the CPU and (if supported) on the GPU.
+    void begin(const char *name) {
+        int gpu = -1;
+        GpuFrame &frame = gpuFrames[frameIndex % FRAME_LAG];
+        if (gpuTimers && frame.count < MAX_SECTIONS) {
+            gpu = frame.count++;
+            frame.sections[gpu].name = name;
+            glQueryCounter(frame.sections[gpu].begin, GL_TIMESTAMP);
+        }
+        open.push_back({name, now(), gpu});
+    }
+
+    void end() {
+        if (open.empty())
+            return;
+        OpenSection s = open.back();
+        open.pop_back();
+        if (s.gpu >= 0)
+            glQueryCounter(gpuFrames[frameIndex % FRAME_LAG].sections[s.gpu].end, GL_TIMESTAMP);
+        record({s.name, 'X', 1, s.start, now() - s.start, 0});
+    }
+
+    void drawCall(int n = 1) { drawCalls += n; }
+    void stateChange(int n = 1) { stateChanges += n; }
+
+    // Frame time statistics over the last HISTORY frames, in milliseconds.
+    void summary(double &min, double &avg, double &p99) const {
+        min = avg = p99 = 0;
+        if (!count)
+            return;
+        std::vector<double> sorted(times, times + count);
+        std::sort(sorted.begin(), sorted.end());
+        for (double t : sorted)
+            avg += t;
+        avg /= count;
+        min = sorted.front();
+        p99 = sorted[std::min(count - 1, count * 99 / 100)];
+    }
+
+    // Text for the on-screen overlay, one entry per line.
+    std::vector<std::string> overlay() const {
+        double min, avg, p99;
+        summary(min, avg, p99);
+        char line[128];
+        std::vector<std::string> lines;
+        snprintf(line, sizeof(line), "frame ms  min %.2f  avg %.2f  p99 %.2f", min, avg, p99);
+        lines.push_back(line);
+        if (gpuTimers) {
+            snprintf(line, sizeof(line), "gpu ms    %.2f", lastGpuFrame);
+            lines.push_back(line);
+        }
+        snprintf(line, sizeof(line), "draws %d  state changes %d", lastDrawCalls, lastStateChanges);
+        lines.push_back(line);
+        return lines;
+    }
+
+    int lastFrameDrawCalls() const { return lastDrawCalls; }
+    int lastFrameStateChanges() const { return lastStateChanges; }
+
+    // Writes all recorded events in the Chrome trace event format.
+    bool writeTrace(const std::string &path) {
+        // Make sure the GPU events of the last frames are in
+        if (gpuTimers)
+            for (auto &f : gpuFrames)
+                resolveGpu(f);
+
+        std::ofstream file(path);
+        file << "{\"traceEvents\":[\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+        file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+        char line[256];
+        for (const Event &e : events) {
+            if (e.phase == 'C')
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                         "\"args\":{\"draw calls\":%g,\"state changes\":%g}}",
+                         e.name, e.tid, e.ts, e.dur, e.value);
+            else
+                snprintf(line, sizeof(line),
+                         ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                         e.name, e.tid, e.ts, e.dur);
+            file << line;
+        }
+        file << "\n]}\n";
+        return (bool)file;
+    }
+};
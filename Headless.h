@@ -0,0 +1,152 @@
+#pragma once
+#include <GL/glew.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <FL/Fl_PNG_Image.H>
+
+// An EGL context without any window, rendering into a framebuffer object.
+// Prefers the Mesa surfaceless platform so it also works on machines with no
+// X server and no GPU (llvmpipe).
+class HeadlessContext {
+    EGLDisplay display;
+    EGLContext context;
+    EGLSurface surface;
+    GLuint fbo, color, depth;
+    int width, height;
+
+    static bool hasExtension(const char *list, const char *name) {
+        if (!list)
+            return false;
+        size_t n = strlen(name);
+        for (const char *p = strstr(list, name); p; p = strstr(p + n, name))
+            if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0'))
+                return true;
+        return false;
+    }
+
+    EGLDisplay openDisplay() {
+        const char *client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (hasExtension(client, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay) {
+                EGLDisplay d = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+                if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL))
+                    return d;
+            }
+        }
+        EGLDisplay d = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (d != EGL_NO_DISPLAY && eglInitialize(d, NULL, NULL))
+            return d;
+        return EGL_NO_DISPLAY;
+    }
+
+  public:
+    HeadlessContext()
+        : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT), surface(EGL_NO_SURFACE), fbo(0), color(0),
+          depth(0), width(0), height(0) {}
+
+    ~HeadlessContext() {
+        if (fbo) {
+            glDeleteFramebuffers(1, &fbo);
+            glDeleteRenderbuffers(1, &color);
+            glDeleteRenderbuffers(1, &depth);
+        }
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (surface != EGL_NO_SURFACE)
+                eglDestroySurface(display, surface);
+            if (context != EGL_NO_CONTEXT)
+                eglDestroyContext(display, context);
+            eglTerminate(display);
+        }
+    }
+
+    // Creates the context, makes it current, initialises GLEW and binds a
+    // w x h RGBA8 + depth framebuffer.
+    bool create(int w, int h) {
+        display = openDisplay();
+        if (display == EGL_NO_DISPLAY) {
+            std::cout << "EGL: no display available" << std::endl;
+            return false;
+        }
+        eglBindAPI(EGL_OPENGL_API);
+
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE,
+        };
+        EGLConfig config = NULL;
+        EGLint count = 0;
+        eglChooseConfig(display, configAttribs, &config, 1, &count);
+
+        // The shaders need GL 4.0; ask for a compatibility context like GLUT's
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 0,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT, EGL_NONE,
+        };
+        context = eglCreateContext(display, count ? config : (EGLConfig)0, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "EGL: failed to create an OpenGL 4.0 context" << std::endl;
+            return false;
+        }
+
+        const char *ext = eglQueryString(display, EGL_EXTENSIONS);
+        if (!hasExtension(ext, "EGL_KHR_surfaceless_context") && count) {
+            const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            std::cout << "EGL: eglMakeCurrent failed" << std::endl;
+            return false;
+        }
+
+        // GLEW may complain that there is no GLX display; entry points still load
+        glewExperimental = GL_TRUE;
+        GLenum err = glewInit();
+        if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY) {
+            std::cout << "GLEW: " << glewGetErrorString(err) << std::endl;
+            return false;
+        }
+
+        width = w;
+        height = h;
+        glGenRenderbuffers(1, &color);
+        glBindRenderbuffer(GL_RENDERBUFFER, color);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+        glGenRenderbuffers(1, &depth);
+        glBindRenderbuffer(GL_RENDERBUFFER, depth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Offscreen framebuffer is incomplete" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    GLuint framebuffer() const { return fbo; }
+
+    // Writes the current contents of the framebuffer as an RGB PNG.
+    bool savePng(const std::string &filename) {
+        std::vector<unsigned char> pixels((size_t)width * height * 3);
+        std::vector<unsigned char> flipped(pixels.size());
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+        // GL rows go bottom-up
+        size_t row = (size_t)width * 3;
+        for (int y = 0; y < height; y++)
+            memcpy(&flipped[row * y], &pixels[row * (height - 1 - y)], row);
+        return fl_write_png(filename.c_str(), flipped.data(), width, height, 3) == 0;
+    }
+};
@@ -3,87 +3,134 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #define PI 3.141592f
 
 class MyWidget : public Fl_Window {
+    // limita lui N, ca 8 * N (vx, vy) si 16 * N (laturi) sa ramana departe
+    // de cel mai mare int
+    static const int N_MAX = 1 << 20;
+
     int xc, yc;       // centrul ferestrei
-    float x[4], y[4]; // coordonatele varfurilor unui patrat
+    float x[4], y[4]; // varfurile patratului initial, fata de centru
     int N;            // nr de patrate
+    int raza, latura;
+
+    // Varfurile celor 2N patrate, fata de centru: intai cele albastre, apoi
+    // cele rosii, cate 4 de patrat. Fiecare patrat se calculeaza direct din
+    // unghiul lui (nu rotind patratul precedent), deci nu se aduna erori de
+    // la o redesenare la alta; tabelul se refoloseste cat timp N, raza si
+    // latura raman aceleasi, iar centrul se adauga abia la desenare.
+    std::vector<float> vx, vy;
+    int N_calculat, raza_calculata, latura_calculata;
+    std::vector<int> laturi; // capetele laturilor, pentru fl_segments
+
+    void calculeaza() {
+        if (N == N_calculat && raza == raza_calculata && latura == latura_calculata)
+            return;
+        vx.resize(8 * N);
+        vy.resize(8 * N);
+        for (int i = 0; i < N; i++) {
+            float u = 2 * PI * (i + 1) / N;
+            float c = cos(u), s = sin(u);
+            // albastru: patratul initial rotit cu u in jurul centrului
+            // rosu: patratul initial mutat pe cerc in punctul de unghi u,
+            // fara sa se roteasca (rotatia cu u in jurul centrului e anulata
+            // de rotatia cu -u in jurul centrului patratului)
+            for (int j = 0; j < 4; j++) {
+                vx[4 * i + j] = x[j] * c - y[j] * s;
+                vy[4 * i + j] = x[j] * s + y[j] * c;
+                vx[4 * (N + i) + j] = x[j] - raza + raza * c;
+                vy[4 * (N + i) + j] = y[j] + raza * s;
+            }
+        }
+        N_calculat = N;
+        raza_calculata = raza;
+        latura_calculata = latura;
+    }
+
+    // Deseneaza patratele [de, pana) din tabel: laturile lor intr-un singur
+    // fl_segments, deci un XDrawSegments pe X11 pentru fiecare culoare; pe
+    // platformele fara varianta pe loturi fiecare patrat devine un loop().
+    void desen(int de, int pana) {
+        laturi.resize(16 * (pana - de));
+        int *l = laturi.data();
+        for (int i = de; i < pana; i++)
+            for (int j = 0; j < 4; j++) {
+                int a = 4 * i + j, b = 4 * i + (j + 1) % 4;
+                *l++ = vx[a] + xc;
+                *l++ = vy[a] + yc;
+                *l++ = vx[b] + xc;
+                *l++ = vy[b] + yc;
+            }
+        fl_segments(4 * (pana - de), laturi.data());
+    }
 
   public:
     MyWidget() : Fl_Window(200, 200, 512, 512, "SPG Lab1") {
         xc = this->w() / 2;
         yc = this->h() / 2;
         N = 10;
+        N_calculat = 0;
         init_obiect(100, 40);
     }
 
-    void desen() {
-        // deseneaza un patrat cu varfurile (x[0] y[0]), (x[1] y[1]), etc.
-        for (int i = 0; i < 3; i++) {
-            fl_line(x[i], y[i], x[i + 1], y[i + 1]);
-        }
-        fl_line(x[3], y[3], x[0], y[0]);
-    }
-
     void init_obiect(int raza, int latura) {
         // functie ce calculeaza coordonatele varfurilor in pozitia initiala
-        x[0] = raza - latura / 2.0 + xc;
-        y[0] = -latura / 2.0 + xc;
+        this->raza = raza;
+        this->latura = latura;
 
-        x[1] = raza + latura / 2.0 + xc;
-        y[1] = -latura / 2.0 + xc;
+        x[0] = raza - latura / 2.0;
+        y[0] = -latura / 2.0;
 
-        x[2] = raza + latura / 2.0 + xc;
-        y[2] = latura / 2.0 + xc;
+        x[1] = raza + latura / 2.0;
+        y[1] = -latura / 2.0;
 
-        x[3] = raza - latura / 2.0 + xc;
-        y[3] = latura / 2.0 + xc;
-    }
+        x[2] = raza + latura / 2.0;
+        y[2] = latura / 2.0;
 
-    void draw() override {
-        Fl_Window::draw(); // apeleaza metoda din clasa de baza pentru a desena
-                           // background-ul
+        x[3] = raza - latura / 2.0;
+        y[3] = latura / 2.0;
+        N_calculat = 0;
+    }
 
-        float du = 2 * PI / N; // unghiul dintre doua patrate succesive
-        float c = cos(du);
-        float s = sin(du);
-        fl_color(FL_BLUE);
-        for (int i = 0; i < N; i++) {
-            for (int j = 0; j < 4; ++j) {
-                float xcp = x[j];
-                float ycp = y[j];
+    void numar_patrate(int n) {
+        N = std::max(1, std::min(N_MAX, n));
+        redraw();
+    }
 
-                x[j] = (xcp - xc) * c - (ycp - yc) * s + xc;
-                y[j] = (xcp - xc) * s + (ycp - yc) * c + yc;
+    int handle(int event) override {
+        // + / - dubleaza / injumatateste numarul de patrate
+        if (event == FL_KEYBOARD) {
+            if (Fl::event_text()[0] == '+') {
+                numar_patrate(N * 2);
+                return 1;
+            }
+            if (Fl::event_text()[0] == '-') {
+                numar_patrate(N / 2);
+                return 1;
             }
-            desen();
         }
+        return Fl_Window::handle(event);
+    }
 
-        fl_color(FL_RED);
-        for (int i = 0; i < N; i++) {
-            for (int j = 0; j < 4; ++j) {
-                float xcp = x[j];
-                float ycp = y[j];
-
-                x[j] = (xcp - xc) * c - (ycp - yc) * s + xc;
-                y[j] = (xcp - xc) * s + (ycp - yc) * c + yc;
+    void draw() override {
+        Fl_Window::draw(); // apeleaza metoda din clasa de baza pentru a desena
+                           // background-ul
 
-                xcp = x[j];
-                ycp = y[j];
+        // centrul urmareste fereastra; tabelul nu depinde de el
+        xc = this->w() / 2;
+        yc = this->h() / 2;
+        calculeaza();
 
-                float x_square_center = cos((2 * PI / N) * (i + 1)) * 100 + xc;
-                float y_square_center = sin((2 * PI / N) * (i + 1)) * 100 + yc;
+        fl_color(FL_BLUE);
+        desen(0, N);
 
-                x[j] = (xcp - x_square_center) * cos(-du) -
-                       (ycp - y_square_center) * sin(-du) + x_square_center;
-                y[j] = (xcp - x_square_center) * sin(-du) +
-                       (ycp - y_square_center) * cos(-du) + y_square_center;
-            }
-            desen();
-        }
+        fl_color(FL_RED);
+        desen(N, 2 * N);
     }
 };
@@ -1,14 +1,557 @@
 #pragma once
 #include "FL/Enumerations.H"
 #include <FL/Fl.H>
+#include <FL/Fl_Input.H>
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <emmintrin.h>
+
+#include "WorkerPool.h"
 
 #define PI 3.141592f
 
+// Esantioanele unei functii, y[i] = f(x0 + i * pas), decimate pe coloane de
+// pixeli: din fiecare coloana se pastreaza doar minimul, maximul, primul si
+// ultimul esantion, deci un grafic cu milioane de esantioane se traseaza
+// cu O(pixeli) linii. Nivelul L grupeaza cate 2^L esantioane; un nivel se
+// calculeaza (din nivelul mai fin) la prima folosire si ramane in cache,
+// asa ca zoom-ul si deplasarea nu mai parcurg esantioanele.
+class Decimare {
+  public:
+    struct Coloana {
+        float ymin, ymax;    // extremele esantioanelor din coloana
+        float yprim, yultim; // primul si ultimul esantion, pt legaturi
+        bool gol;            // nici un esantion finit (ex. sqrt(-1))
+
+        void adauga(const Coloana &c) {
+            if (c.gol)
+                return;
+            if (gol) {
+                *this = c;
+                return;
+            }
+            ymin = std::min(ymin, c.ymin);
+            ymax = std::max(ymax, c.ymax);
+            yultim = c.yultim;
+        }
+        void adauga(float y) {
+            if (std::isfinite(y))
+                adauga(Coloana{y, y, y, y, false});
+        }
+    };
+
+  private:
+    // Sub 2^NIVEL_MIN esantioane pe coloana se lucreaza direct pe esantioane
+    static const int NIVEL_MIN = 4;
+
+    std::vector<float> y;
+    float x0, pas;
+    std::map<int, std::vector<Coloana>> niveluri;
+
+    const std::vector<Coloana> &nivel(int L) {
+        auto it = niveluri.find(L);
+        if (it != niveluri.end())
+            return it->second;
+        size_t grup = (size_t)1 << L;
+        std::vector<Coloana> c((y.size() + grup - 1) / grup, Coloana{0, 0, 0, 0, true});
+        if (L == NIVEL_MIN) {
+            for (size_t i = 0; i < y.size(); i++)
+                c[i >> L].adauga(y[i]);
+        } else {
+            const std::vector<Coloana> &fin = nivel(L - 1);
+            for (size_t i = 0; i < fin.size(); i++)
+                c[i >> 1].adauga(fin[i]);
+        }
+        return niveluri[L] = std::move(c);
+    }
+
+  public:
+    Decimare() : x0(0), pas(1) {}
+
+    // Inlocuieste esantioanele si goleste cache-ul.
+    void seteaza(float start, float p, std::vector<float> &&esantioane) {
+        x0 = start;
+        pas = p;
+        y = std::move(esantioane);
+        niveluri.clear();
+    }
+
+    std::vector<float> &esantioane() { return y; }
+    float xmin() const { return x0; }
+    float xmax() const { return x0 + pas * y.size(); }
+    float pasul() const { return pas; }
+
+    // Cate o coloana pentru fiecare din cei nr pixeli care acopera [xa, xb).
+    void coloane(float xa, float xb, int nr, std::vector<Coloana> &out) {
+        out.assign(nr, Coloana{0, 0, 0, 0, true});
+        if (y.empty() || nr <= 0 || xb <= xa)
+            return;
+        double pePixel = (xb - xa) / pas / nr; // esantioane pe pixel
+        // indicele primului esantion din pixelul p
+        auto inceput = [&](int p) {
+            double i = std::ceil((xa - x0) / pas + p * pePixel);
+            return (long long)std::max(0.0, std::min((double)y.size(), i));
+        };
+        int L = pePixel >= 1 ? (int)std::floor(std::log2(pePixel)) : 0;
+        if (L < NIVEL_MIN) {
+            for (int p = 0; p < nr; p++)
+                for (long long i = inceput(p), e = inceput(p + 1); i < e; i++)
+                    out[p].adauga(y[i]);
+            return;
+        }
+        // Pixelul p primeste grupurile care incep in el; eroarea e sub un
+        // grup, adica sub un pixel
+        const std::vector<Coloana> &c = nivel(L);
+        for (int p = 0; p < nr; p++) {
+            long long a = (inceput(p) + ((1ll << L) - 1)) >> L, b = (inceput(p + 1) + ((1ll << L) - 1)) >> L;
+            for (long long g = a; g < b; g++)
+                out[p].adauga(c[g]);
+        }
+    }
+};
+
+// sin si cos pentru 4 valori deodata (SSE2): reducere la [-pi/4, pi/4] in
+// trei pasi (Cody-Waite) si polinoamele din Cephes. Eroare ~1e-7 pentru
+// |x| < 8192; dincolo de asta reducerea in float nu mai e exacta.
+inline void sincos_ps(__m128 x, __m128 &s, __m128 &c) {
+    const __m128 semn = _mm_set1_ps(-0.0f);
+    __m128 semn_sin = _mm_and_ps(x, semn);
+    x = _mm_andnot_ps(semn, x);
+
+    // j = cel mai apropiat multiplu par al lui x / (pi/4)
+    __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f)));
+    j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(j);
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+
+    // cadranul decide semnele si daca sin si cos isi schimba polinoamele
+    semn_sin = _mm_xor_ps(semn_sin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+    __m128 semn_cos = _mm_castsi128_ps(
+        _mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    __m128 schimba = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_setzero_si128()));
+
+    __m128 z = _mm_mul_ps(x, x);
+    __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(-1.388731625493765e-3f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+    pc = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(pc, z), z), _mm_mul_ps(z, _mm_set1_ps(0.5f))),
+                    _mm_set1_ps(1.0f));
+    __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+    ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+
+    s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(schimba, ps), _mm_andnot_ps(schimba, pc)), semn_sin);
+    c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(schimba, pc), _mm_andnot_ps(schimba, ps)), semn_cos);
+}
+
+// y[i] = op(x[i]) cate 4 valori deodata; restul trece prin acelasi cod, ca
+// rezultatele sa nu depinda de pozitia in lot. x si y pot coincide.
+template <class Op> inline void lot_ps(const float *x, float *y, size_t n, Op op) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(y + i, op(_mm_loadu_ps(x + i)));
+    if (i < n) {
+        float xr[4] = {0, 0, 0, 0}, yr[4];
+        memcpy(xr, x + i, (n - i) * sizeof(float));
+        _mm_storeu_ps(yr, op(_mm_loadu_ps(xr)));
+        memcpy(y + i, yr, (n - i) * sizeof(float));
+    }
+}
+
+// Expresie in x introdusa de utilizator, ex. "sin(4x) * x^2 / 3".
+// Se analizeaza o singura data intr-un arbore, constantele se calculeaza
+// la compilare (2*pi/4 devine 1.5708), iar arborele devine un cod pentru
+// o masina cu stiva. Codul se executa pe loturi: fiecare instructiune
+// parcurge un lot intreg de valori, deci bucla interioara e una simpla,
+// vectorizabila, nu un apel pe esantion. Nu e nevoie de compilator extern.
+//
+// Gramatica: + - * / ^ (la dreapta), minus unar, paranteze, numere, x,
+// pi, e, functiile sin cos tan sqrt abs exp log asin acos atan floor si
+// inmultirea implicita (4x, 2sin(x), (x+1)(x-1)).
+class Expresie {
+    enum Op : uint8_t {
+        CONST, X, ADD, SUB, MUL, DIV, POW, NEG,
+        // operand constant in dreapta (k - a si k / a pentru R*)
+        ADDK, SUBK, RSUBK, MULK, DIVK, RDIVK, POWK,
+        SIN, COS, TAN, SQRT, ABS, EXP, LOG, ASIN, ACOS, ATAN, FLOOR
+    };
+
+    struct Nod {
+        Op op;
+        float k;
+        std::unique_ptr<Nod> a, b;
+    };
+
+    struct Instr {
+        Op op;
+        float k;
+    };
+
+    static const int ADANCIME_MAX = 32; // a stivei de loturi
+    static constexpr size_t LOT = 256;
+
+    std::vector<Instr> cod;
+    std::string eroare;
+
+    // analiza
+    const char *s, *inceput;
+    bool greseala;
+
+    void gresit(const std::string &mesaj) {
+        if (!greseala)
+            eroare = mesaj + " la pozitia " + std::to_string(s - inceput + 1);
+        greseala = true;
+    }
+
+    void spatii() {
+        while (*s == ' ' || *s == '\t')
+            s++;
+    }
+
+    static std::unique_ptr<Nod> nod(Op op, float k, std::unique_ptr<Nod> a = NULL, std::unique_ptr<Nod> b = NULL) {
+        std::unique_ptr<Nod> n(new Nod{op, k, std::move(a), std::move(b)});
+        return n;
+    }
+
+    std::unique_ptr<Nod> suma() {
+        std::unique_ptr<Nod> a = produs();
+        for (spatii(); !greseala && (*s == '+' || *s == '-'); spatii()) {
+            Op op = *s++ == '+' ? ADD : SUB;
+            a = nod(op, 0, std::move(a), produs());
+        }
+        return a;
+    }
+
+    std::unique_ptr<Nod> produs() {
+        std::unique_ptr<Nod> a = unar();
+        for (spatii(); !greseala; spatii()) {
+            if (*s == '*' || *s == '/') {
+                Op op = *s++ == '*' ? MUL : DIV;
+                a = nod(op, 0, std::move(a), unar());
+            } else if (*s == '(' || isalpha((unsigned char)*s) || isdigit((unsigned char)*s) || *s == '.')
+                a = nod(MUL, 0, std::move(a), putere()); // inmultire implicita
+            else
+                break;
+        }
+        return a;
+    }
+
+    std::unique_ptr<Nod> unar() {
+        spatii();
+        if (*s == '-') {
+            s++;
+            return nod(NEG, 0, unar());
+        }
+        if (*s == '+') {
+            s++;
+            return unar();
+        }
+        return putere();
+    }
+
+    std::unique_ptr<Nod> putere() {
+        std::unique_ptr<Nod> a = primar();
+        spatii();
+        if (!greseala && *s == '^') {
+            s++;
+            return nod(POW, 0, std::move(a), unar());
+        }
+        return a;
+    }
+
+    std::unique_ptr<Nod> primar() {
+        spatii();
+        if (isdigit((unsigned char)*s) || *s == '.') {
+            // doar zecimal: strtof ar citi si 0x2 sau 0x1p3 ca numere hexa
+            const char *p = s;
+            while (isdigit((unsigned char)*p))
+                p++;
+            if (*p == '.')
+                for (p++; isdigit((unsigned char)*p);)
+                    p++;
+            if (p - s == 1 && *s == '.') {
+                gresit("numar invalid");
+                return nod(CONST, 0);
+            }
+            // un e fara cifre dupa el nu e exponent, ci constanta: 2e = 2*e,
+            // 2exp(x) = 2*exp(x), 2e-x = 2*e-x
+            if (*p == 'e' || *p == 'E') {
+                const char *q = p + 1;
+                if (*q == '+' || *q == '-')
+                    q++;
+                if (isdigit((unsigned char)*q)) {
+                    while (isdigit((unsigned char)*q))
+                        q++;
+                    p = q;
+                }
+            }
+            float v = strtof(std::string(s, p).c_str(), NULL);
+            s = p;
+            // 1.2.3 sau 1e5.5 nu sunt 1.2*.3 sau 1e5*.5
+            if (*s == '.' || isdigit((unsigned char)*s))
+                gresit("numar invalid");
+            return nod(CONST, v);
+        }
+        if (*s == '(') {
+            s++;
+            std::unique_ptr<Nod> a = suma();
+            spatii();
+            if (*s != ')')
+                gresit("lipseste )");
+            else
+                s++;
+            return a;
+        }
+        if (isalpha((unsigned char)*s)) {
+            // numele au doar litere, ca x2 sa fie x*2
+            const char *nume = s;
+            while (isalpha((unsigned char)*s))
+                s++;
+            std::string id(nume, s);
+            if (id == "x")
+                return nod(X, 0);
+            if (id == "pi")
+                return nod(CONST, PI);
+            if (id == "e")
+                return nod(CONST, 2.718281828f);
+            static const struct {
+                const char *nume;
+                Op op;
+            } functii[] = {{"sin", SIN},   {"cos", COS},   {"tan", TAN},   {"sqrt", SQRT},
+                           {"abs", ABS},   {"exp", EXP},   {"log", LOG},   {"ln", LOG},
+                           {"asin", ASIN}, {"acos", ACOS}, {"atan", ATAN}, {"floor", FLOOR}};
+            for (auto &f : functii)
+                if (id == f.nume) {
+                    spatii();
+                    if (*s != '(') {
+                        gresit("lipseste ( dupa " + id);
+                        return nod(CONST, 0);
+                    }
+                    return nod(f.op, 0, primar());
+                }
+            s = nume;
+            gresit("necunoscut: " + id);
+            return nod(CONST, 0);
+        }
+        gresit(*s ? "caracter neasteptat" : "expresie incompleta");
+        return nod(CONST, 0);
+    }
+
+    // Calculeaza op pe un lot: a = op(a) sau a = a op b.
+    static void aplica(Op op, float k, float *a, const float *b, size_t n) {
+        switch (op) {
+        case ADD: for (size_t i = 0; i < n; i++) a[i] += b[i]; break;
+        case SUB: for (size_t i = 0; i < n; i++) a[i] -= b[i]; break;
+        case MUL: for (size_t i = 0; i < n; i++) a[i] *= b[i]; break;
+        case DIV: for (size_t i = 0; i < n; i++) a[i] /= b[i]; break;
+        case POW: for (size_t i = 0; i < n; i++) a[i] = std::pow(a[i], b[i]); break;
+        case NEG: for (size_t i = 0; i < n; i++) a[i] = -a[i]; break;
+        case ADDK: for (size_t i = 0; i < n; i++) a[i] += k; break;
+        case SUBK: for (size_t i = 0; i < n; i++) a[i] -= k; break;
+        case RSUBK: for (size_t i = 0; i < n; i++) a[i] = k - a[i]; break;
+        case MULK: for (size_t i = 0; i < n; i++) a[i] *= k; break;
+        case DIVK: for (size_t i = 0; i < n; i++) a[i] /= k; break;
+        case RDIVK: for (size_t i = 0; i < n; i++) a[i] = k / a[i]; break;
+        case POWK:
+            if (k == 2)
+                for (size_t i = 0; i < n; i++) a[i] *= a[i];
+            else if (k == 0.5f)
+                lot_ps(a, a, n, [](__m128 v) { return _mm_sqrt_ps(v); });
+            else
+                for (size_t i = 0; i < n; i++) a[i] = std::pow(a[i], k);
+            break;
+        case SIN:
+        case COS:
+        case TAN:
+            lot_ps(a, a, n, [op](__m128 v) {
+                __m128 sn, cs;
+                sincos_ps(v, sn, cs);
+                return op == SIN ? sn : op == COS ? cs : _mm_div_ps(sn, cs);
+            });
+            break;
+        case SQRT: lot_ps(a, a, n, [](__m128 v) { return _mm_sqrt_ps(v); }); break;
+        case ABS: lot_ps(a, a, n, [](__m128 v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }); break;
+        case EXP: for (size_t i = 0; i < n; i++) a[i] = std::exp(a[i]); break;
+        case LOG: for (size_t i = 0; i < n; i++) a[i] = std::log(a[i]); break;
+        case ASIN: for (size_t i = 0; i < n; i++) a[i] = std::asin(a[i]); break;
+        case ACOS: for (size_t i = 0; i < n; i++) a[i] = std::acos(a[i]); break;
+        case ATAN: for (size_t i = 0; i < n; i++) a[i] = std::atan(a[i]); break;
+        case FLOOR: for (size_t i = 0; i < n; i++) a[i] = std::floor(a[i]); break;
+        default: break;
+        }
+    }
+
+    static bool binar(Op op) { return op >= ADD && op <= POW; }
+
+    // Inlocuieste subarborii fara x cu valoarea lor, apoi alege varianta
+    // cu operand constant a operatorilor binari.
+    static void simplifica(std::unique_ptr<Nod> &n) {
+        if (n->a)
+            simplifica(n->a);
+        if (n->b)
+            simplifica(n->b);
+        bool ca = n->a && n->a->op == CONST, cb = n->b && n->b->op == CONST;
+        if (n->a && ca && (!n->b || cb)) {
+            float a = n->a->k, b = n->b ? n->b->k : 0;
+            aplica(n->op, 0, &a, &b, 1);
+            n = nod(CONST, a);
+            return;
+        }
+        if (!binar(n->op) || (!ca && !cb))
+            return;
+        static const Op dreapta[] = {ADDK, SUBK, MULK, DIVK, POWK}; // a op k
+        static const Op stanga[] = {ADDK, RSUBK, MULK, RDIVK, CONST}; // k op b
+        Op op = cb ? dreapta[n->op - ADD] : stanga[n->op - ADD];
+        if (op == CONST) // k ^ x ramane general
+            return;
+        float k = cb ? n->b->k : n->a->k;
+        std::unique_ptr<Nod> rest = std::move(cb ? n->a : n->b);
+        n = nod(op, k, std::move(rest));
+    }
+
+    // Emite codul in postordine si intoarce adancimea maxima a stivei.
+    int emite(const Nod &n) {
+        int da = n.a ? emite(*n.a) : 0;
+        int db = n.b ? emite(*n.b) : 0;
+        cod.push_back({n.op, n.k});
+        if (!n.a)
+            return 1;
+        return std::max(da, db + 1);
+    }
+
+  public:
+    // Compileaza textul; la o greseala codul vechi ramane, iar mesaj()
+    // spune ce si unde.
+    bool compileaza(const std::string &text) {
+        s = inceput = text.c_str();
+        greseala = false;
+        std::unique_ptr<Nod> radacina = suma();
+        spatii();
+        if (!greseala && *s)
+            gresit("caracter neasteptat");
+        if (greseala)
+            return false;
+        simplifica(radacina);
+        std::vector<Instr> vechi;
+        vechi.swap(cod);
+        if (emite(*radacina) > ADANCIME_MAX) {
+            cod.swap(vechi);
+            eroare = "expresie prea complexa";
+            return false;
+        }
+        eroare.clear();
+        return true;
+    }
+
+    const std::string &mesaj() const { return eroare; }
+    bool gol() const { return cod.empty(); }
+    size_t instructiuni() const { return cod.size(); }
+
+    // y[i] = valoarea expresiei in x[i]; se poate apela de pe mai multe fire.
+    void evalueaza(const float *x, float *y, size_t n) const {
+        float stiva[ADANCIME_MAX][LOT];
+        for (size_t i0 = 0; i0 < n; i0 += LOT) {
+            size_t m = std::min(LOT, n - i0);
+            int v = -1; // varful stivei
+            for (const Instr &in : cod)
+                switch (in.op) {
+                case X:
+                    memcpy(stiva[++v], x + i0, m * sizeof(float));
+                    break;
+                case CONST:
+                    v++;
+                    std::fill(stiva[v], stiva[v] + m, in.k);
+                    break;
+                default:
+                    if (binar(in.op)) {
+                        v--;
+                        aplica(in.op, in.k, stiva[v], stiva[v + 1], m);
+                    } else
+                        aplica(in.op, in.k, stiva[v], NULL, m);
+                }
+            memcpy(y + i0, stiva[0], m * sizeof(float));
+        }
+    }
+
+    float operator()(float x) const {
+        float y;
+        evalueaza(&x, &y, 1);
+        return y;
+    }
+};
+
+// Coada circulara fara blocare intre un singur producator (de ex. firul
+// care citeste un senzor) si un singur consumator (firul FLTK). Fiecare
+// capat modifica doar indicele lui, iar capacitatea e o putere a lui 2,
+// deci pozitia unui element e indicele & masca. Cei doi indici stau pe
+// linii de cache diferite, ca firele sa nu si le fure una alteia.
+template <class T> class InelSPSC {
+    static const size_t LINIE = 64;
+
+    std::vector<T> date;
+    size_t masca;
+    alignas(LINIE) std::atomic<size_t> scris; // modificat doar de producator
+    size_t citit_vazut;                       // ultimul citit vazut de producator
+    alignas(LINIE) std::atomic<size_t> citit; // modificat doar de consumator
+
+  public:
+    explicit InelSPSC(size_t capacitate) : scris(0), citit_vazut(0), citit(0) {
+        size_t c = 1;
+        while (c < capacitate)
+            c <<= 1;
+        date.resize(c);
+        masca = c - 1;
+    }
+    InelSPSC(const InelSPSC &) = delete;
+    InelSPSC &operator=(const InelSPSC &) = delete;
+
+    size_t capacitate() const { return date.size(); }
+
+    // Producatorul: adauga cat incape din v[0..n) si intoarce cate a
+    // adaugat. Nu asteapta niciodata consumatorul.
+    size_t pune(const T *v, size_t n) {
+        size_t s = scris.load(std::memory_order_relaxed);
+        if (date.size() - (s - citit_vazut) < n)
+            citit_vazut = citit.load(std::memory_order_acquire);
+        n = std::min(n, date.size() - (s - citit_vazut));
+        for (size_t i = 0; i < n; i++)
+            date[(s + i) & masca] = v[i];
+        scris.store(s + n, std::memory_order_release);
+        return n;
+    }
+    bool pune(const T &v) { return pune(&v, 1) == 1; }
+
+    // Consumatorul: scoate cel mult max elemente in out, in ordinea in care
+    // au fost puse, si intoarce cate a scos.
+    size_t citeste(T *out, size_t max) {
+        size_t c = citit.load(std::memory_order_relaxed);
+        size_t n = std::min(max, scris.load(std::memory_order_acquire) - c);
+        for (size_t i = 0; i < n; i++)
+            out[i] = date[(c + i) & masca];
+        citit.store(c + n, std::memory_order_release);
+        return n;
+    }
+};
+
 class MyWidget : public Fl_Window {
+  public:
+    // UNIFORM esantioneaza cu pasul dat; ADAPTIV imparte intervalul doar
+    // unde graficul se schimba vizibil si nu uneste punctele peste poli
+    enum Mod { UNIFORM, ADAPTIV };
+
+  private:
     float XFm, XFM, YFm, YFM;
     int XPm, XPM, YPm, YPM;
     int tip_tran; // tip_tran == 0 -> scalare neuniforma, tip_tran != 0 ->
@@ -18,11 +561,198 @@ class MyWidget : public Fl_Window {
     int width, height;
 
     typedef float (*MyFuncPtrType)(float);
+    // varianta pe loturi: y[i] = f(x[i]) pentru i < n
+    typedef void (*MyBatchFuncPtrType)(const float *x, float *y, size_t n);
+
+    // esantioanele functiei desenate, recalculate doar cand se schimba
+    // functia, intervalul sau pasul
+    Decimare decimare;
+    WorkerPool fire; // sub 2^16 esantioane nu merita trezite firele
+    const void *f_esantionata;
+    float xmin_esantionat, xmax_esantionat, pas_esantionat;
+    std::vector<Decimare::Coloana> coloane;
+    // capetele segmentelor (sau punctele poliliniei) trimise deodata cu
+    // fl_segments / fl_polyline
+    std::vector<int> segmente;
+
+    // intervalul vizibil (zoom cu rotita, deplasare cu mouse-ul)
+    float vxm, vxM;
+    bool zoom;
+    int x_apasat;
+
+    // mod ADAPTIV: punctele in ordinea lui x; y = NAN intrerupe linia
+    struct Punct {
+        float x, y;
+    };
+    Mod mod;
+    std::vector<Punct> puncte;
+    size_t evaluari; // apeluri ale lui f la ultima trasare adaptiva
+
+    // functia scrisa de utilizator; daca intrarea e goala se deseneaza f2
+    Expresie expresie;
+    Fl_Input *intrare;
+    bool are_expresie;
+
+    // esantioane pentru o expresie (in modul UNIFORM)
+    static const int ESANTIOANE_EXPRESIE = 2000000;
+
+    static void la_modificare(Fl_Widget *w, void *data) {
+        ((MyWidget *)data)->expresie_noua(((Fl_Input *)w)->value());
+    }
+
+    // modul flux: fiecare canal are inelul lui (un producator) si ultimele
+    // coloane de pixeli, coloana c la istoric[c % latime_flux]; coloana c
+    // are pe_coloana esantioane
+    struct Canal {
+        std::unique_ptr<InelSPSC<float>> inel;
+        Fl_Color culoare;
+        std::vector<Decimare::Coloana> istoric;
+        Decimare::Coloana curenta; // coloana care se umple
+        int in_curenta;
+        long long complete, desenate;
+    };
+    std::vector<Canal> canale;
+    bool flux;
+    int pe_coloana, latime_flux;
+    float fymin, fymax;
+    double perioada;   // intre doua redesenari, in secunde
+    long long afisat;  // coloana de langa marginea din dreapta la ultima desenare
+
+    // Inelele se golesc la fiecare perioada; graficul se deruleaza doar daca
+    // a venit cel putin o coloana, deci se redeseneaza de cel mult 1/perioada
+    // ori pe secunda oricat de repede ar scrie producatorii.
+    static void la_timp(void *data) {
+        MyWidget *w = (MyWidget *)data;
+        if (w->colecteaza())
+            w->damage(FL_DAMAGE_USER1);
+        Fl::repeat_timeout(w->perioada, la_timp, data);
+    }
+
+    // fl_scroll apeleaza asta pentru banda ramasa descoperita (sau pentru
+    // toata zona daca nu s-a putut copia): fundal, axa x si coloanele din
+    // istoric care cad in banda
+    static void banda(void *data, int X, int Y, int W, int H) {
+        MyWidget *w = (MyWidget *)data;
+        fl_push_clip(X, Y, W, H);
+        fl_rectf(X, Y, W, H, w->color());
+        fl_color(FL_WHITE);
+        if (w->YFm < 0 && w->YFM > 0)
+            fl_line(X, w->YDisp(0), X + W, w->YDisp(0));
+        long long de = w->afisat + X - w->XPM;
+        for (Canal &k : w->canale)
+            w->deseneaza_coloane(k, de, de + W);
+        fl_pop_clip();
+    }
 
   public:
     MyWidget(int width = 512, int height = 512)
         : Fl_Window(200, 200, width, height, "SPG Lab2"), width(width),
-          height(height) {}
+          height(height), fire(1 << 16), f_esantionata(NULL), xmin_esantionat(0), xmax_esantionat(0),
+          pas_esantionat(0), vxm(0), vxM(0), zoom(false), x_apasat(0), mod(UNIFORM), evaluari(0),
+          are_expresie(false), flux(false), pe_coloana(1), latime_flux(0), fymin(-1), fymax(1),
+          perioada(1.0 / 60), afisat(0) {
+        begin();
+        intrare = new Fl_Input(80, height / 2 + 10, width - 130, 24, "f(x) =");
+        intrare->when(FL_WHEN_CHANGED);
+        intrare->callback(la_modificare, this);
+        end();
+        fire.start();
+    }
+    ~MyWidget() { Fl::remove_timeout(la_timp, this); }
+
+    // Un canal nou pentru modul flux, desenat cu culoarea data. Inelul
+    // intors se da unui singur fir producator, care il umple cu pune();
+    // ce nu mai incape (daca firul FLTK ramane in urma) e refuzat, nu
+    // asteptat. Producatorii trebuie opriti inainte de distrugerea ferestrei.
+    InelSPSC<float> &canal_nou(Fl_Color culoare, size_t capacitate = 1 << 16) {
+        Canal k;
+        k.inel.reset(new InelSPSC<float>(capacitate));
+        k.culoare = culoare;
+        k.istoric.assign(latime_flux, Decimare::Coloana{0, 0, 0, 0, true});
+        k.curenta = Decimare::Coloana{0, 0, 0, 0, true};
+        k.in_curenta = 0;
+        k.complete = k.desenate = afisat;
+        canale.push_back(std::move(k));
+        return *canale.back().inel;
+    }
+
+    // Deseneaza canalele pe masura ce vin datele: coloana cea mai noua e in
+    // dreapta si la fiecare redesenare graficul se muta spre stanga cu
+    // numarul de coloane noi, desenand doar banda descoperita. Intervalul
+    // [ymin, ymax] e fix, altfel o valoare noua ar muta tot graficul.
+    // Coloana c inseamna acelasi moment pe toate canalele, deci producatorii
+    // trebuie sa aiba aceeasi frecventa; un canal ramas in urma isi
+    // completeaza coloanele pe masura ce ii vin datele.
+    void porneste_flux(float ymin, float ymax, int esantioane_pe_coloana = 1, double fps = 60) {
+        init_grafic();
+        poarta();
+        fymin = ymin;
+        fymax = ymax;
+        pe_coloana = std::max(1, esantioane_pe_coloana);
+        perioada = 1.0 / fps;
+        // sub ~150 px fereastra nu mai are poarta; istoricul are totusi
+        // macar o coloana, ca indicii % latime_flux sa ramana valizi
+        latime_flux = std::max(1, XPM - XPm);
+        afisat = 0;
+        for (Canal &k : canale) {
+            k.istoric.assign(latime_flux, Decimare::Coloana{0, 0, 0, 0, true});
+            k.curenta = Decimare::Coloana{0, 0, 0, 0, true};
+            k.in_curenta = 0;
+            k.complete = k.desenate = 0;
+        }
+        flux = true;
+        Fl::remove_timeout(la_timp, this);
+        Fl::add_timeout(perioada, la_timp, this);
+        redraw();
+    }
+
+    void opreste_flux() {
+        Fl::remove_timeout(la_timp, this);
+        flux = false;
+        redraw();
+    }
+
+    // Muta in istoric esantioanele venite de la producatori; true daca s-a
+    // completat cel putin o coloana. Dintr-un inel se ia cel mult cat
+    // incape in el, ca un producator rapid sa nu tina firul FLTK pe loc.
+    bool colecteaza() {
+        float lot[1024];
+        bool noi = false;
+        for (Canal &k : canale) {
+            size_t n;
+            for (size_t luate = 0; luate < k.inel->capacitate() && (n = k.inel->citeste(lot, 1024)) > 0;
+                 luate += n)
+                for (size_t i = 0; i < n; i++) {
+                    k.curenta.adauga(lot[i]);
+                    if (++k.in_curenta < pe_coloana)
+                        continue;
+                    k.istoric[k.complete++ % latime_flux] = k.curenta;
+                    k.curenta = Decimare::Coloana{0, 0, 0, 0, true};
+                    k.in_curenta = 0;
+                    noi = true;
+                }
+        }
+        return noi;
+    }
+
+    // Se apeleaza la fiecare tasta: expresia se recompileaza si, daca e
+    // corecta, graficul se reface; altfel ramane cel vechi si se afiseaza
+    // greseala.
+    void expresie_noua(const char *text) {
+        if (!*text)
+            are_expresie = false;
+        else if (expresie.compileaza(text)) {
+            are_expresie = true;
+            f_esantionata = NULL; // aceeasi cheie, alta functie
+        }
+        redraw();
+    }
+
+    void mod_grafic(Mod m) {
+        mod = m;
+        redraw();
+    }
+    size_t evaluari_adaptive() const { return evaluari; }
 
     void init_grafic() {
         XFm = YFm = XFM = YFM = 0;
@@ -48,6 +778,13 @@ class MyWidget : public Fl_Window {
         // transformarea fereastra-poarta pt coordonata y
         return yf * sy + ty;
     }
+    void poarta() {
+        int stg = 50, drt = 50;
+        XPm = stg;
+        XPM = width / 2 - drt / 2;
+        YPm = stg;
+        YPM = height / 2 - drt / 2;
+    }
     void cadru_poarta() {
         fl_line(XPm, YPm, XPm, YPM);
         fl_line(XPm, YPM, XPM, YPM);
@@ -59,21 +796,172 @@ class MyWidget : public Fl_Window {
     static float f2(float x) { return tan(x); }
     static float f3(float x) { return sin(4 * x); }
 
+    // f1, f2, f3 pe loturi, cate 4 valori deodata
+    static void f1_lot(const float *x, float *y, size_t n) {
+        lot_ps(x, y, n, [](__m128 v) {
+            __m128 s, c;
+            sincos_ps(v, s, c);
+            return s;
+        });
+    }
+    static void f2_lot(const float *x, float *y, size_t n) {
+        lot_ps(x, y, n, [](__m128 v) {
+            __m128 s, c;
+            sincos_ps(v, s, c);
+            return _mm_div_ps(s, c);
+        });
+    }
+    static void f3_lot(const float *x, float *y, size_t n) {
+        lot_ps(x, y, n, [](__m128 v) {
+            __m128 s, c;
+            sincos_ps(_mm_mul_ps(v, _mm_set1_ps(4.0f)), s, c);
+            return s;
+        });
+    }
+
+    // Esantioneaza [xmin, xmax - pas) cu pasul pas daca functia (cheie) sau
+    // intervalul s-au schimbat; eval(x, y, n) primeste loturi de x si
+    // intervalul e impartit intre fire.
+    template <class Eval>
+    void esantioneaza(float xmin, float xmax, float pas, const void *cheie, const Eval &eval) {
+        if (cheie == f_esantionata && xmin == xmin_esantionat && xmax == xmax_esantionat && pas == pas_esantionat)
+            return;
+        size_t n = (size_t)std::max(0.0, std::ceil((xmax - pas - xmin) / (double)pas));
+        std::vector<float> y(n);
+        fire.parallelFor(n, [&](size_t inceput, size_t sfarsit) {
+            const size_t LOT = 1024;
+            float x[LOT];
+            for (size_t i = inceput; i < sfarsit; i += LOT) {
+                size_t m = std::min(LOT, sfarsit - i);
+                for (size_t k = 0; k < m; k++)
+                    x[k] = xmin + (i + k) * pas;
+                eval(x, &y[i], m);
+            }
+        });
+        decimare.seteaza(xmin, pas, std::move(y));
+        f_esantionata = cheie;
+        xmin_esantionat = xmin;
+        xmax_esantionat = xmax;
+        pas_esantionat = pas;
+        zoom = false;
+    }
+
+    // f se apeleaza de pe mai multe fire, deci nu trebuie sa aiba stare
     void grafic(float xmin, float xmax, float pas, MyFuncPtrType f) {
-        XFm = xmin;
-        XFM = xmax;
-        // se determina YFm si YFM ca fiind valoarea minima, respectiv maxima a
-        // functiei f in intervalul XFm, XFM
-        for (float x = xmin; x < xmax - pas; x += pas) {
-            auto fx = f(x);
-            YFm = fx < YFm ? fx : YFm;
-            YFM = fx > YFM ? fx : YFM;
-        }
+        esantioneaza(xmin, xmax, pas, (const void *)f, [f](const float *x, float *y, size_t n) {
+            for (size_t i = 0; i < n; i++)
+                y[i] = f(x[i]);
+        });
+        grafic_esantionat(xmin, xmax);
+    }
+
+    void grafic(float xmin, float xmax, float pas, MyBatchFuncPtrType f) {
+        esantioneaza(xmin, xmax, pas, (const void *)f, f);
+        grafic_esantionat(xmin, xmax);
+    }
+
+    void grafic(float xmin, float xmax, float pas, const Expresie &e) {
+        esantioneaza(xmin, xmax, pas, (const void *)&e,
+                     [&e](const float *x, float *y, size_t n) { e.evalueaza(x, y, n); });
+        grafic_esantionat(xmin, xmax);
+    }
+
+    // Traseaza esantioanele curente; ambele treceri (domeniul pe y si
+    // desenul) folosesc acelasi tampon evaluat.
+    void segment(int x1, int y1, int x2, int y2) {
+        int s[4] = {x1, y1, x2, y2};
+        segmente.insert(segmente.end(), s, s + 4);
+    }
+    void traseaza_segmente() {
+        fl_segments((int)segmente.size() / 4, segmente.data());
+        segmente.clear();
+    }
+
+    void grafic_esantionat(float xmin, float xmax) {
+        XFm = zoom ? vxm : xmin;
+        XFM = zoom ? vxM : xmax;
+
+        // o coloana decimata pe pixel; YFm si YFM (minimul, respectiv
+        // maximul functiei f in intervalul XFm, XFM) rezulta din coloane,
+        // fara o trecere separata prin esantioane
+        decimare.coloane(XFm, XFM, XPM - XPm, coloane);
+        for (const Decimare::Coloana &c : coloane)
+            if (!c.gol) {
+                YFm = std::min(YFm, c.ymin);
+                YFM = std::max(YFM, c.ymax);
+            }
         if ((YFM - YFm) / (XFM - XFm) > 5) {
             YFM = 5 * (XFM - XFm);
             YFm = -5 * (XFM - XFm);
         }
 
+        cadru_si_axe();
+        // trasare grafic: pe fiecare coloana un segment vertical de la
+        // minim la maxim, plus legatura cu coloana precedenta; toate
+        // segmentele pleaca intr-un singur apel
+
+        auto limitat = [&](float y) { return std::max(YFm, std::min(YFM, y)); };
+        auto in_afara = [&](float y) { return y > YFM || y < YFm; };
+        float pas = decimare.pasul();
+        if ((XFM - XFm) / pas < XPM - XPm) {
+            // sub un esantion pe pixel coloanele sunt goale sau au un singur
+            // punct, deci se unesc direct esantioanele vecine, la x-ul lor
+            const std::vector<float> &y = decimare.esantioane();
+            long long i = (long long)std::floor((XFm - decimare.xmin()) / pas);
+            long long sf = (long long)std::ceil((XFM - decimare.xmin()) / pas);
+            i = std::max(0ll, i);
+            sf = std::min((long long)y.size() - 1, sf);
+            for (; i < sf; i++) {
+                float xa = decimare.xmin() + i * pas, xb = xa + pas;
+                float ya = y[i], yb = y[i + 1];
+                if (!std::isfinite(ya) || !std::isfinite(yb))
+                    continue;
+                // capetele din afara ferestrei se aduc pe marginea ei
+                if (xa < XFm) {
+                    ya += (yb - ya) * (XFm - xa) / pas;
+                    xa = XFm;
+                }
+                if (xb > XFM) {
+                    yb += (yb - ya) * (XFM - xb) / (xb - xa);
+                    xb = XFM;
+                }
+                if (!(in_afara(ya) && in_afara(yb)))
+                    segment(XDisp(xa), YDisp(limitat(ya)), XDisp(xb), YDisp(limitat(yb)));
+            }
+            traseaza_segmente();
+            return;
+        }
+        const Decimare::Coloana *prec = NULL;
+        for (size_t p = 0; p < coloane.size(); p++) {
+            const Decimare::Coloana &c = coloane[p];
+            if (c.gol) {
+                prec = NULL;
+                continue;
+            }
+            int xp = XPm + (int)p;
+            // ca inainte, nu se traseaza intre doua puncte in afara ferestrei
+            if (prec && !(in_afara(prec->yultim) && in_afara(c.yprim)))
+                segment(xp - 1, YDisp(limitat(prec->yultim)), xp, YDisp(limitat(c.yprim)));
+            if (!in_afara(c.ymin) || !in_afara(c.ymax)) {
+                int ya = YDisp(limitat(c.ymin)), yb = YDisp(limitat(c.ymax));
+                if (ya != yb)
+                    segment(xp, ya, xp, yb);
+            } else {
+                // coloana trece prin toata fereastra (ex. asimptota lui tan):
+                // doar capetele din fereastra se prelungesc spre marginea
+                // cea mai apropiata
+                float mijloc = (YFm + YFM) / 2;
+                if (!in_afara(c.yprim))
+                    segment(xp, YDisp(c.yprim), xp, YDisp(c.yprim > mijloc ? YFM : YFm));
+                if (!in_afara(c.yultim))
+                    segment(xp, YDisp(c.yultim), xp, YDisp(c.yultim > mijloc ? YFM : YFm));
+            }
+            prec = &c;
+        }
+        traseaza_segmente();
+    }
+
+    void cadru_si_axe() {
         cadru_poarta();
         calctran();
         // trasarea axei x
@@ -84,63 +972,285 @@ class MyWidget : public Fl_Window {
         if (XFm < 0 && XFM > 0) {
             fl_line(XDisp(0), YPm, XDisp(0),  YPM);
         }
-        // trasare grafic
-
-        float last_y, last_x;
+    }
 
-        bool first = true;
-        bool last_crossed = false;
-        bool can_draw = true;
-        for (float x = xmin; x < xmax - pas; x += pas) {
-            auto y = f(x);
+    // Adauga punctele dintre a si b (exclusiv) pana cand doua puncte
+    // consecutive sunt la cel mult un pixel distanta pe y, sau pana cand
+    // mijlocul e la cel mult o jumatate de pixel de coarda. Un salt care nu scade
+    // oricat de ingust ar deveni intervalul e un pol (sau o discontinuitate)
+    // si intrerupe linia.
+    template <class F> void rafineaza(const Punct &a, const Punct &b, const F &f) {
+        const float LATIME_MIN = 1.0f / 64; // pixeli
+        float pa = a.y * sy + ty, pb = b.y * sy + ty, latime = (b.x - a.x) * sx;
+        bool finite = std::isfinite(a.y) && std::isfinite(b.y);
+        if (finite) {
+            // de aceeasi parte in afara ferestrei: nu se vede nimic
+            if ((a.y > YFM && b.y > YFM) || (a.y < YFm && b.y < YFm))
+                return;
+            if (std::fabs(pb - pa) <= 1)
+                return;
+        }
+        if (latime < LATIME_MIN) {
+            puncte.push_back({b.x, NAN});
+            return;
+        }
+        Punct m = {(a.x + b.x) / 2, f((a.x + b.x) / 2)};
+        evaluari++;
+        if (finite && std::isfinite(m.y) && std::fabs(m.y * sy + ty - (pa + pb) / 2) <= 0.5f)
+            return;
+        // nedefinita peste tot (ex. sqrt(x) pentru x < 0): o singura
+        // intrerupere; se injumatatesc doar intervalele cu un singur capat
+        // finit, ca sa se gaseasca marginea domeniului
+        if (!std::isfinite(a.y) && !std::isfinite(b.y) && !std::isfinite(m.y)) {
+            puncte.push_back({b.x, NAN});
+            return;
+        }
+        rafineaza(a, m, f);
+        puncte.push_back(m);
+        rafineaza(m, b, f);
+    }
 
-            if (!first) {
-                if (y > YFM || y < YFm) {
-                    if (y > YFM) {
-                        y = YFM;
-                    }
-                    if (y < YFm) {
-                        y = YFm;
-                    }
-                    if (last_crossed) {
-                        can_draw = false;
-                    }
+    // Deseneaza f pe [xmin, xmax] in modul ADAPTIV: o esantionare grosiera
+    // (un punct la 4 pixeli) da domeniul pe y, apoi se rafineaza doar unde
+    // e nevoie. Fara euristica pentru tan: valorile din jurul polilor nu
+    // intra in domeniu, iar liniile nu trec peste poli.
+    template <class F> void grafic_adaptiv(float xmin, float xmax, const F &f) {
+        XFm = zoom ? vxm : xmin;
+        XFM = zoom ? vxM : xmax;
+        int n = std::max(8, (XPM - XPm) / 4);
+        std::vector<Punct> grosier(n + 1);
+        std::vector<float> valori;
+        for (int i = 0; i <= n; i++) {
+            float x = XFm + (XFM - XFm) * i / n;
+            grosier[i] = {x, f(x)};
+            if (std::isfinite(grosier[i].y))
+                valori.push_back(grosier[i].y);
+        }
+        evaluari = n + 1;
 
-                    last_crossed = true;
-                } else {
-                    last_crossed = false;
-                    can_draw = true;
+        // YFm, YFM: valorile care nu sunt departe de percentilele 5 si 95
+        if (!valori.empty()) {
+            std::sort(valori.begin(), valori.end());
+            float p5 = valori[valori.size() * 5 / 100], p95 = valori[valori.size() * 95 / 100];
+            float d = std::max(p95 - p5, 1e-6f);
+            for (float v : valori)
+                if (v >= p5 - d && v <= p95 + d) {
+                    YFm = std::min(YFm, v);
+                    YFM = std::max(YFM, v);
                 }
+        }
+        cadru_si_axe();
+        if (sx == 0 || sy == 0)
+            return;
+
+        puncte.clear();
+        for (int i = 0; i < n; i++) {
+            puncte.push_back(grosier[i]);
+            rafineaza(grosier[i], grosier[i + 1], f);
+        }
+        puncte.push_back(grosier[n]);
 
-                if (can_draw) {
-                    fl_line(XDisp(last_x), YDisp(last_y), XDisp(x), YDisp(y));
+        // fiecare segment se taie la [YFm, YFM]; segmentele consecutive
+        // netaiate formeaza o singura polilinie
+        bool deschisa = false;
+        auto inchide = [&] {
+            if (deschisa)
+                fl_polyline((int)segmente.size() / 2, segmente.data());
+            segmente.clear();
+            deschisa = false;
+        };
+        auto varf = [&](float x, float y) {
+            segmente.push_back(XDisp(x));
+            segmente.push_back(YDisp(y));
+        };
+        for (size_t i = 0; i + 1 < puncte.size(); i++) {
+            Punct p = puncte[i], q = puncte[i + 1];
+            if (!std::isfinite(p.y) || !std::isfinite(q.y)) {
+                inchide();
+                continue;
+            }
+            // taierea parametrica pe y
+            float t0 = 0, t1 = 1, dy = q.y - p.y;
+            for (float limita : {YFm, YFM}) {
+                bool jos = limita == YFm;
+                if (dy == 0) {
+                    if (jos ? p.y < limita : p.y > limita)
+                        t0 = 2;
+                    continue;
                 }
+                float t = (limita - p.y) / dy;
+                if ((dy > 0) == jos)
+                    t0 = std::max(t0, t);
+                else
+                    t1 = std::min(t1, t);
+            }
+            if (t0 > t1) {
+                inchide();
+                continue;
+            }
+            if (t0 > 0)
+                inchide();
+            if (!deschisa) {
+                varf(p.x + (q.x - p.x) * t0, p.y + dy * t0);
+                deschisa = true;
             }
+            varf(p.x + (q.x - p.x) * t1, p.y + dy * t1);
+            if (t1 < 1)
+                inchide();
+        }
+        inchide();
+    }
 
-            last_y = y;
-            last_x = x;
-            first = false;
+    // Coloanele [de, pana) ale canalului k care mai sunt in istoric si in
+    // poarta, fiecare cu legatura de la coloana dinainte.
+    void deseneaza_coloane(Canal &k, long long de, long long pana) {
+        de = std::max({de, k.complete - latime_flux, afisat - latime_flux + 1, 0LL});
+        pana = std::min(pana, k.complete);
+        auto Y = [&](float y) { return YDisp(std::min(std::max(y, YFm), YFM)); };
+        fl_color(k.culoare);
+        for (long long c = de; c < pana; c++) {
+            const Decimare::Coloana &col = k.istoric[c % latime_flux];
+            if (col.gol)
+                continue;
+            int xp = XDisp((float)(c - afisat));
+            if (c > std::max(k.complete - latime_flux, 0LL)) {
+                const Decimare::Coloana &prec = k.istoric[(c - 1) % latime_flux];
+                if (!prec.gol)
+                    segment(xp - 1, Y(prec.yultim), xp, Y(col.yprim));
+            }
+            segment(xp, Y(col.ymin), xp, Y(col.ymax));
         }
+        traseaza_segmente();
+    }
+
+    long long capat_flux() const {
+        long long capat = afisat;
+        for (const Canal &k : canale)
+            capat = std::max(capat, k.complete);
+        return capat;
+    }
+
+    // Redesenarea completa: x in coloane relativ la marginea din dreapta,
+    // ca sx = 1 si derularea sa nu schimbe transformarea.
+    void grafic_flux() {
+        afisat = capat_flux();
+        XFm = (float)-latime_flux;
+        XFM = 0;
+        YFm = fymin;
+        YFM = fymax;
+        cadru_si_axe();
+        fl_push_clip(XPm + 1, YPm + 1, XPM - XPm - 1, YPM - YPm - 1);
+        for (Canal &k : canale) {
+            deseneaza_coloane(k, afisat - latime_flux, afisat);
+            k.desenate = k.complete;
+        }
+        fl_pop_clip();
+    }
+
+    // Redesenarea la date noi: restul graficului se copiaza spre stanga cu
+    // fl_scroll si se deseneaza doar coloanele din banda noua, plus cele
+    // ale canalelor ramase in urma, completate de atunci mai la stanga.
+    void deruleaza() {
+        long long capat = capat_flux();
+        int dx = (int)std::min(capat - afisat, (long long)latime_flux);
+        int X = XPm + 1, Y = YPm + 1, W = XPM - XPm - 1, H = YPM - YPm - 1;
+        afisat = capat;
+        if (dx > 0 && W > 0 && H > 0)
+            fl_scroll(X, Y, W, H, -dx, 0, banda, this);
+        fl_push_clip(X, Y, W, H);
+        for (Canal &k : canale) {
+            deseneaza_coloane(k, k.desenate, afisat - dx);
+            k.desenate = k.complete;
+        }
+        fl_pop_clip();
     }
 
     void text(const char *str) { fl_draw(str, XPm, YPM + 12); }
 
+    int handle(int event) override {
+        // clicul si rotita peste campul de text sunt ale lui (cursor,
+        // selectie); tragerile pornite acolo ii ajung direct, prin Fl::pushed()
+        if ((event == FL_PUSH || event == FL_MOUSEWHEEL) && Fl::event_inside(intrare))
+            return Fl_Window::handle(event);
+        if (!zoom && (event == FL_MOUSEWHEEL || event == FL_PUSH)) {
+            vxm = XFm;
+            vxM = XFM;
+        }
+        switch (event) {
+        case FL_MOUSEWHEEL: {
+            // zoom in jurul punctului de sub cursor
+            if (sx == 0)
+                return 1;
+            float centru = (Fl::event_x() - tx) / sx;
+            float k = std::pow(1.25f, (float)Fl::event_dy());
+            vxm = centru + (vxm - centru) * k;
+            vxM = centru + (vxM - centru) * k;
+            zoom = true;
+            redraw();
+            return 1;
+        }
+        case FL_PUSH:
+            x_apasat = Fl::event_x();
+            return 1;
+        case FL_KEYBOARD:
+        case FL_SHORTCUT:
+            // F2, nu o litera: literele le consuma campul de text
+            if (Fl::event_key() == FL_F + 2) {
+                mod_grafic(mod == ADAPTIV ? UNIFORM : ADAPTIV);
+                return 1;
+            }
+            break;
+        case FL_DRAG: {
+            if (sx == 0)
+                return 1;
+            float dx = (Fl::event_x() - x_apasat) / sx;
+            vxm -= dx;
+            vxM -= dx;
+            x_apasat = Fl::event_x();
+            zoom = true;
+            redraw();
+            return 1;
+        }
+        }
+        return Fl_Window::handle(event);
+    }
+
     void draw() override {
+        // in modul flux, daca s-au schimbat doar datele, nu se sterge nimic
+        if (flux && !(damage() & ~(FL_DAMAGE_USER1 | FL_DAMAGE_CHILD))) {
+            if (damage() & FL_DAMAGE_USER1)
+                deruleaza();
+            if (damage() & FL_DAMAGE_CHILD)
+                draw_children();
+            return;
+        }
+        Fl_Window::draw();
         fl_color(FL_WHITE);
 
-        int xmaxe, ymaxe, stg = 50, drt = 50;
         float pas = 0.01;
         init_grafic();
+        poarta();
 
-        xmaxe = width;
-        ymaxe = height;
-
-        XPm = stg;
-        XPM = xmaxe / 2 - drt / 2;
-        YPm = stg;
-        YPM = ymaxe / 2 - drt / 2;
-
-        grafic(-5, 5, pas, f2);
-        text("sin(x)");
+        if (flux) {
+            grafic_flux();
+            fl_color(FL_WHITE);
+            text("flux");
+        } else if (are_expresie) {
+            if (mod == ADAPTIV)
+                grafic_adaptiv(-5, 5, expresie);
+            else
+                grafic(-5, 5, 10.0f / ESANTIOANE_EXPRESIE, expresie);
+            text(intrare->value());
+        } else {
+            if (mod == ADAPTIV)
+                grafic_adaptiv(-5, 5, f2);
+            else
+                grafic(-5, 5, pas, f2_lot);
+            text("sin(x)");
+        }
+        if (!expresie.mesaj().empty() && *intrare->value()) {
+            fl_color(FL_RED);
+            fl_draw(expresie.mesaj().c_str(), intrare->x(), intrare->y() + intrare->h() + 14);
+        }
     }
 };
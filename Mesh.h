@@ -0,0 +1,432 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Triangle meshes in a compact binary format (.smesh). OBJ and PLY files
+// are imported once (spg --import-mesh); at runtime the file is mapped with
+// mmap and the vertex and index blocks are handed to glBufferStorage
+// directly, so loading costs one copy into GL memory and nothing else.
+//
+// Vertices are 20 bytes, interleaved:
+//   float    position[3]
+//   uint32   normal      GL_INT_2_10_10_10_REV, snorm
+//   uint16   uv[2]       half float
+// followed by 32-bit indices.
+class Mesh {
+  public:
+    struct Vertex {
+        float position[3];
+        uint32_t normal;
+        uint16_t uv[2];
+    };
+
+    struct Header {
+        char magic[4]; // "SMSH"
+        uint32_t version;
+        uint32_t vertexCount, indexCount;
+        float boundsMin[3], boundsMax[3];
+        uint64_t vertexOffset, indexOffset;
+    };
+
+    static constexpr uint32_t fileVersion = 1;
+
+  private:
+    GLuint vao, buffers[2];
+    uint32_t indices;
+    float lo[3], hi[3];
+
+    // ---- import -------------------------------------------------------
+
+    struct Source {
+        std::vector<float> positions, normals, uvs; // per vertex: 3, 3, 2
+        std::vector<uint32_t> triangles;
+    };
+
+    static uint16_t toHalf(float f) {
+        uint32_t x;
+        memcpy(&x, &f, 4);
+        uint32_t sign = (x >> 16) & 0x8000;
+        int exponent = (int)((x >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = x & 0x7fffff;
+        if (exponent <= 0)
+            return (uint16_t)sign; // flush denormals to zero
+        if (exponent >= 31)
+            return (uint16_t)(sign | 0x7c00);
+        // round to nearest
+        uint32_t h = sign | (exponent << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000)
+            h++;
+        return (uint16_t)h;
+    }
+
+    static uint32_t packNormal(const float *n) {
+        float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; i++) {
+            float v = len > 0 ? n[i] / len : 0.0f;
+            int q = (int)std::lround(std::max(-1.0f, std::min(1.0f, v)) * 511.0f);
+            packed |= ((uint32_t)q & 0x3ff) << (10 * i);
+        }
+        return packed;
+    }
+
+    // Area-weighted vertex normals for sources without any.
+    static void computeNormals(Source &mesh) {
+        mesh.normals.assign(mesh.positions.size(), 0.0f);
+        for (size_t t = 0; t + 2 < mesh.triangles.size(); t += 3) {
+            const float *p[3];
+            for (int k = 0; k < 3; k++)
+                p[k] = &mesh.positions[mesh.triangles[t + k] * 3];
+            float e1[3], e2[3], n[3];
+            for (int i = 0; i < 3; i++) {
+                e1[i] = p[1][i] - p[0][i];
+                e2[i] = p[2][i] - p[0][i];
+            }
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            for (int k = 0; k < 3; k++)
+                for (int i = 0; i < 3; i++)
+                    mesh.normals[mesh.triangles[t + k] * 3 + i] += n[i];
+        }
+    }
+
+    // OBJ: v / vt / vn / f, polygons are triangulated as fans and every
+    // distinct v/vt/vn triple becomes one vertex.
+    static bool readObj(const std::string &path, Source &mesh) {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::vector<float> v, vt, vn;
+        std::unordered_map<std::string, uint32_t> unique; // keyed by the resolved v/vt/vn indices
+        std::string line;
+        bool hasNormals = false;
+        while (std::getline(file, line)) {
+            std::istringstream in(line);
+            std::string tag;
+            in >> tag;
+            if (tag == "v" || tag == "vn") {
+                float x = 0, y = 0, z = 0;
+                in >> x >> y >> z;
+                std::vector<float> &dst = tag == "v" ? v : vn;
+                dst.insert(dst.end(), {x, y, z});
+            } else if (tag == "vt") {
+                float s = 0, t = 0;
+                in >> s >> t;
+                vt.insert(vt.end(), {s, t});
+            } else if (tag == "f") {
+                std::vector<uint32_t> polygon;
+                std::string corner;
+                while (in >> corner) {
+                    // v, v/vt, v//vn or v/vt/vn; negative indices count from the end
+                    long idx[3] = {0, 0, 0};
+                    const char *c = corner.c_str();
+                    for (int k = 0; k < 3 && *c; k++) {
+                        if (*c != '/')
+                            idx[k] = strtol(c, (char **)&c, 10);
+                        if (*c == '/')
+                            c++;
+                    }
+                    size_t counts[3] = {v.size() / 3, vt.size() / 2, vn.size() / 3};
+                    for (int k = 0; k < 3; k++)
+                        if (idx[k] < 0)
+                            idx[k] += counts[k] + 1;
+                    if (idx[0] < 1 || (size_t)idx[0] > counts[0])
+                        return false;
+                    for (int k = 1; k < 3; k++)
+                        if (idx[k] < 1 || (size_t)idx[k] > counts[k])
+                            idx[k] = 0;
+                    // Relative corners only name the same vertex once resolved
+                    std::string key((const char *)idx, sizeof(idx));
+                    auto it = unique.find(key);
+                    if (it != unique.end()) {
+                        polygon.push_back(it->second);
+                        continue;
+                    }
+                    uint32_t vertex = (uint32_t)(mesh.positions.size() / 3);
+                    mesh.positions.insert(mesh.positions.end(), &v[(idx[0] - 1) * 3], &v[(idx[0] - 1) * 3] + 3);
+                    if (idx[1])
+                        mesh.uvs.insert(mesh.uvs.end(), &vt[(idx[1] - 1) * 2], &vt[(idx[1] - 1) * 2] + 2);
+                    else
+                        mesh.uvs.insert(mesh.uvs.end(), {0.0f, 0.0f});
+                    if (idx[2]) {
+                        mesh.normals.insert(mesh.normals.end(), &vn[(idx[2] - 1) * 3], &vn[(idx[2] - 1) * 3] + 3);
+                        hasNormals = true;
+                    } else
+                        mesh.normals.insert(mesh.normals.end(), {0.0f, 0.0f, 0.0f});
+                    unique[key] = vertex;
+                    polygon.push_back(vertex);
+                }
+                for (size_t k = 2; k < polygon.size(); k++)
+                    mesh.triangles.insert(mesh.triangles.end(), {polygon[0], polygon[k - 1], polygon[k]});
+            }
+        }
+        if (!hasNormals)
+            computeNormals(mesh);
+        return !mesh.triangles.empty();
+    }
+
+    // PLY, ascii or binary_little_endian: vertex x/y/z, optional nx/ny/nz
+    // and s/t (or u/v), face vertex_indices lists (triangulated as fans).
+    static bool readPly(const std::string &path, Source &mesh) {
+        std::ifstream file(path, std::ios::binary);
+        std::string line;
+        if (!std::getline(file, line) || line.compare(0, 3, "ply") != 0)
+            return false;
+
+        struct Property {
+            std::string name, type, countType; // countType set for lists
+        };
+        struct Element {
+            std::string name;
+            size_t count;
+            std::vector<Property> properties;
+        };
+        std::vector<Element> elements;
+        bool binary = false;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            std::istringstream in(line);
+            std::string tag;
+            in >> tag;
+            if (tag == "format") {
+                std::string format;
+                in >> format;
+                if (format == "binary_little_endian")
+                    binary = true;
+                else if (format != "ascii")
+                    return false;
+            } else if (tag == "element") {
+                Element e;
+                in >> e.name >> e.count;
+                elements.push_back(e);
+            } else if (tag == "property" && !elements.empty()) {
+                Property p;
+                in >> p.type;
+                if (p.type == "list")
+                    in >> p.countType >> p.type;
+                in >> p.name;
+                elements.back().properties.push_back(p);
+            } else if (tag == "end_header")
+                break;
+        }
+
+        auto size = [](const std::string &type) -> int {
+            if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+                return 1;
+            if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+                return 2;
+            if (type == "double" || type == "float64")
+                return 8;
+            return 4;
+        };
+        auto read = [&](const std::string &type) -> double {
+            if (!binary) {
+                double value = 0;
+                file >> value;
+                return value;
+            }
+            unsigned char b[8] = {0};
+            file.read((char *)b, size(type));
+            if (type == "char" || type == "int8")
+                return (int8_t)b[0];
+            if (type == "uchar" || type == "uint8")
+                return b[0];
+            if (type == "short" || type == "int16")
+                return (int16_t)(b[0] | b[1] << 8);
+            if (type == "ushort" || type == "uint16")
+                return (uint16_t)(b[0] | b[1] << 8);
+            if (type == "double" || type == "float64") {
+                double d;
+                memcpy(&d, b, 8);
+                return d;
+            }
+            uint32_t u = b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+            if (type == "float" || type == "float32") {
+                float f;
+                memcpy(&f, &u, 4);
+                return f;
+            }
+            return type == "uint" || type == "uint32" ? (double)u : (double)(int32_t)u;
+        };
+
+        bool hasNormals = false;
+        for (const Element &e : elements) {
+            for (size_t i = 0; i < e.count && file; i++) {
+                float vertex[8] = {0, 0, 0, 0, 0, 0, 0, 0}; // x y z nx ny nz s t
+                for (const Property &p : e.properties) {
+                    if (!p.countType.empty()) {
+                        size_t n = (size_t)read(p.countType);
+                        std::vector<uint32_t> polygon(n);
+                        for (size_t k = 0; k < n; k++)
+                            polygon[k] = (uint32_t)read(p.type);
+                        if (e.name == "face" && (p.name == "vertex_indices" || p.name == "vertex_index"))
+                            for (size_t k = 2; k < n; k++)
+                                mesh.triangles.insert(mesh.triangles.end(), {polygon[0], polygon[k - 1], polygon[k]});
+                        continue;
+                    }
+                    double value = read(p.type);
+                    static const char *names[] = {"x", "y", "z", "nx", "ny", "nz", "s", "t", "u", "v"};
+                    for (int k = 0; k < 10; k++)
+                        if (p.name == names[k]) {
+                            vertex[k < 8 ? k : k - 2] = (float)value;
+                            hasNormals |= k >= 3 && k < 6;
+                        }
+                }
+                if (e.name == "vertex") {
+                    mesh.positions.insert(mesh.positions.end(), vertex, vertex + 3);
+                    mesh.normals.insert(mesh.normals.end(), vertex + 3, vertex + 6);
+                    mesh.uvs.insert(mesh.uvs.end(), vertex + 6, vertex + 8);
+                }
+            }
+        }
+        size_t vertices = mesh.positions.size() / 3;
+        for (uint32_t index : mesh.triangles)
+            if (index >= vertices)
+                return false;
+        if (!hasNormals)
+            computeNormals(mesh);
+        return !mesh.triangles.empty();
+    }
+
+  public:
+    Mesh() : vao(0), buffers{0, 0}, indices(0), lo{0, 0, 0}, hi{0, 0, 0} {}
+    ~Mesh() {
+        if (vao) {
+            glDeleteVertexArrays(1, &vao);
+            glDeleteBuffers(2, buffers);
+        }
+    }
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
+    // Converts an .obj or .ply file into the binary format.
+    static bool import(const std::string &source, const std::string &destination) {
+        Source mesh;
+        std::string ext = source.substr(source.find_last_of('.') + 1);
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        bool ok = ext == "obj" ? readObj(source, mesh) : ext == "ply" ? readPly(source, mesh) : false;
+        if (!ok) {
+            std::cout << "Failed to import mesh " << source << std::endl;
+            return false;
+        }
+
+        size_t count = mesh.positions.size() / 3;
+        std::vector<Vertex> vertices(count);
+        Header header = {{'S', 'M', 'S', 'H'}, fileVersion, (uint32_t)count, (uint32_t)mesh.triangles.size(),
+                         {INFINITY, INFINITY, INFINITY}, {-INFINITY, -INFINITY, -INFINITY}, 0, 0};
+        for (size_t i = 0; i < count; i++) {
+            Vertex &v = vertices[i];
+            memcpy(v.position, &mesh.positions[i * 3], sizeof(v.position));
+            for (int k = 0; k < 3; k++) {
+                header.boundsMin[k] = std::min(header.boundsMin[k], v.position[k]);
+                header.boundsMax[k] = std::max(header.boundsMax[k], v.position[k]);
+            }
+            v.normal = packNormal(&mesh.normals[i * 3]);
+            v.uv[0] = toHalf(mesh.uvs[i * 2]);
+            v.uv[1] = toHalf(mesh.uvs[i * 2 + 1]);
+        }
+        header.vertexOffset = sizeof(Header);
+        header.indexOffset = header.vertexOffset + vertices.size() * sizeof(Vertex);
+
+        std::ofstream file(destination, std::ios::binary | std::ios::trunc);
+        file.write((const char *)&header, sizeof(header));
+        file.write((const char *)vertices.data(), vertices.size() * sizeof(Vertex));
+        file.write((const char *)mesh.triangles.data(), mesh.triangles.size() * sizeof(uint32_t));
+        if (!file) {
+            std::cout << "Failed to write " << destination << std::endl;
+            return false;
+        }
+        std::cout << source << ": " << count << " vertices, " << mesh.triangles.size() / 3 << " triangles"
+                  << std::endl;
+        return true;
+    }
+
+    // Maps an .smesh file and creates its VAO with attributes 0 (position),
+    // 1 (normal) and 2 (uv). The VAO is left bound so the caller can add
+    // per-instance attributes.
+    bool load(const std::string &path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cout << "Failed to open mesh " << path << std::endl;
+            return false;
+        }
+        struct stat st;
+        void *data = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header))
+            data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            std::cout << "Failed to map mesh " << path << std::endl;
+            return false;
+        }
+
+        const Header &h = *(const Header *)data;
+        size_t size = st.st_size;
+        size_t vertexBytes = (size_t)h.vertexCount * sizeof(Vertex);
+        size_t indexBytes = (size_t)h.indexCount * sizeof(uint32_t);
+        bool valid = memcmp(h.magic, "SMSH", 4) == 0 && h.version == fileVersion && h.vertexOffset <= size &&
+                     vertexBytes <= size - h.vertexOffset && h.indexOffset <= size &&
+                     indexBytes <= size - h.indexOffset;
+        // glDrawElements does not check the indices, so every one must name
+        // a vertex of the file
+        for (uint32_t i = 0; i < h.indexCount && valid; i++) {
+            uint32_t index;
+            memcpy(&index, (const char *)data + h.indexOffset + i * sizeof(uint32_t), sizeof(index));
+            valid = index < h.vertexCount;
+        }
+        if (!valid) {
+            std::cout << "Invalid mesh file " << path << std::endl;
+            munmap(data, st.st_size);
+            return false;
+        }
+        // The upload reads the file front to back
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+        const char *bytes = (const char *)data;
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        glGenBuffers(2, buffers);
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+        if (GLEW_ARB_buffer_storage) {
+            glBufferStorage(GL_ARRAY_BUFFER, vertexBytes, bytes + h.vertexOffset, 0);
+            glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indexBytes, bytes + h.indexOffset, 0);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, bytes + h.vertexOffset, GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, bytes + h.indexOffset, GL_STATIC_DRAW);
+        }
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(Vertex), (void *)offsetof(Vertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, uv));
+        glEnableVertexAttribArray(2);
+
+        indices = h.indexCount;
+        memcpy(lo, h.boundsMin, sizeof(lo));
+        memcpy(hi, h.boundsMax, sizeof(hi));
+        munmap(data, st.st_size);
+        return true;
+    }
+
+    GLuint vertexArray() const { return vao; }
+    GLsizei indexCount() const { return (GLsizei)indices; }
+    const float *boundsMin() const { return lo; }
+    const float *boundsMax() const { return hi; }
+};
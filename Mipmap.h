@@ -0,0 +1,259 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <immintrin.h>
+
+// Full mip chain of an RGBA8 image (as decoded by stb_image), built on the
+// CPU with a 2x2 box filter. Odd sizes round down like GL does, dropping the
+// last row or column. Colour channels can be averaged in linear light (the
+// texels are sRGB), which keeps mips of high-contrast textures from going
+// dark the way glGenerateMipmap on an RGBA8 texture does; alpha is always
+// averaged as is.
+//
+// The image is cut into TILE x TILE tiles. A tile's texels at every level
+// down to 1/TILE only depend on that tile, so worker threads take whole
+// tiles through all those levels without synchronising between levels; the
+// few small levels left are done at the end on the calling thread. Rows are
+// filtered by SSE2 or AVX2 kernels, picked at run time.
+class Mipmap {
+  public:
+    struct Level {
+        int width, height;
+        size_t offset; // into data()
+    };
+
+    enum Kernel { SCALAR, SSE2, AVX2 };
+
+  private:
+    static const int TILE = 256;
+    static const int TILE_LEVELS = 8; // log2(TILE)
+
+    std::vector<unsigned char> pixels; // levels 1 and up
+    std::vector<Level> levels;         // levels[0] describes the source
+
+    // sRGB <-> 16-bit linear. Decoding is exact per byte; encoding looks the
+    // 12 high bits of the average up, which is finer than one sRGB step
+    // everywhere but the two darkest values.
+    struct Tables {
+        uint32_t toLinear[256];
+        uint8_t toSrgb[4096 + 3]; // padded for 4-byte gathers
+
+        Tables() {
+            for (int i = 0; i < 256; i++) {
+                double c = i / 255.0;
+                double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+                toLinear[i] = (uint32_t)std::lround(l * 65535.0);
+            }
+            memset(toSrgb, 0, sizeof(toSrgb));
+            for (int i = 0; i < 4096; i++) {
+                double l = (i + 0.5) / 4096.0;
+                double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+                toSrgb[i] = (uint8_t)std::lround(std::min(1.0, c) * 255.0);
+            }
+        }
+    };
+
+    static const Tables &tables() {
+        static const Tables t;
+        return t;
+    }
+
+    // Averages the 2x2 blocks of rows a and b into count texels of out.
+    // x is the first output texel; sw, the source width, only matters where
+    // the source is one texel wide.
+    static void rowScalar(const uint8_t *a, const uint8_t *b, uint8_t *out, int x, int count, int sw, bool srgb) {
+        const Tables &t = tables();
+        for (int i = x; i < x + count; i++) {
+            int x0 = 2 * i, x1 = std::min(2 * i + 1, sw - 1);
+            const uint8_t *p[4] = {a + x0 * 4, a + x1 * 4, b + x0 * 4, b + x1 * 4};
+            uint8_t *o = out + i * 4;
+            for (int c = 0; c < 3; c++) {
+                if (srgb)
+                    o[c] = t.toSrgb[(t.toLinear[p[0][c]] + t.toLinear[p[1][c]] + t.toLinear[p[2][c]] +
+                                     t.toLinear[p[3][c]]) >> 6];
+                else
+                    o[c] = (uint8_t)((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) >> 2);
+            }
+            o[3] = (uint8_t)((p[0][3] + p[1][3] + p[2][3] + p[3][3] + 2) >> 2);
+        }
+    }
+
+    // Two output texels per step; SSE2 has no gather, so sRGB rows stay
+    // scalar here.
+    static void rowSse2(const uint8_t *a, const uint8_t *b, uint8_t *out, int x, int count, int sw, bool srgb) {
+        int i = x, end = x + count;
+        if (!srgb) {
+            const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+            for (; i + 2 <= end && 2 * i + 4 <= sw; i += 2) {
+                __m128i ra = _mm_loadu_si128((const __m128i *)(a + i * 8));
+                __m128i rb = _mm_loadu_si128((const __m128i *)(b + i * 8));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(ra, zero), _mm_unpacklo_epi8(rb, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(ra, zero), _mm_unpackhi_epi8(rb, zero));
+                lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8)); // texel 0 + 1 in the low half
+                hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+                _mm_storel_epi64((__m128i *)(out + i * 4), _mm_packus_epi16(sum, sum));
+            }
+        }
+        rowScalar(a, b, out, i, end - i, sw, srgb);
+    }
+
+    // Four output texels per step. sRGB rows decode and encode through the
+    // tables with gathers, and take alpha from the plain average.
+    __attribute__((target("avx2"))) static void rowAvx2(const uint8_t *a, const uint8_t *b, uint8_t *out, int x,
+                                                        int count, int sw, bool srgb) {
+        int i = x, end = x + count;
+        const __m256i zero = _mm256_setzero_si256(), two = _mm256_set1_epi16(2);
+        const Tables &t = tables();
+        for (; i + 4 <= end && 2 * i + 8 <= sw; i += 4) {
+            __m256i ra = _mm256_loadu_si256((const __m256i *)(a + i * 8));
+            __m256i rb = _mm256_loadu_si256((const __m256i *)(b + i * 8));
+            // Per 128-bit lane, exactly as in the SSE2 kernel
+            __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(ra, zero), _mm256_unpacklo_epi8(rb, zero));
+            __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(ra, zero), _mm256_unpackhi_epi8(rb, zero));
+            lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+            hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+            __m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), two), 2);
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+            __m128i result = _mm256_castsi256_si128(packed);
+
+            if (srgb) {
+                // Two output texels at a time: their 2x2 blocks are source
+                // texels 0,1 and 2,3 of both rows, eight channels per gather
+                __m128i colour[2];
+                for (int half = 0; half < 2; half++) {
+                    __m256i sums = _mm256_setzero_si256();
+                    for (int row = 0; row < 2; row++) {
+                        const uint8_t *src = (row ? b : a) + (i + half * 2) * 8;
+                        __m256i t01 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)src));
+                        __m256i t23 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + 8)));
+                        t01 = _mm256_i32gather_epi32((const int *)t.toLinear, t01, 4);
+                        t23 = _mm256_i32gather_epi32((const int *)t.toLinear, t23, 4);
+                        // [t0 | t2] + [t1 | t3]
+                        sums = _mm256_add_epi32(sums, _mm256_add_epi32(_mm256_permute2x128_si256(t01, t23, 0x20),
+                                                                       _mm256_permute2x128_si256(t01, t23, 0x31)));
+                    }
+                    __m256i index = _mm256_srli_epi32(sums, 6);
+                    __m256i srgbBytes = _mm256_and_si256(
+                        _mm256_i32gather_epi32((const int *)t.toSrgb, index, 1), _mm256_set1_epi32(0xff));
+                    __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(srgbBytes),
+                                                     _mm256_extracti128_si256(srgbBytes, 1));
+                    colour[half] = _mm_packus_epi16(words, words);
+                }
+                __m128i alpha = _mm_set1_epi32((int)0xff000000);
+                result = _mm_or_si128(_mm_andnot_si128(alpha, _mm_unpacklo_epi64(colour[0], colour[1])),
+                                      _mm_and_si128(alpha, result));
+            }
+            _mm_storeu_si128((__m128i *)(out + i * 4), result);
+        }
+        rowScalar(a, b, out, i, end - i, sw, srgb);
+    }
+
+    // Output texels [x0, x1) x [y0, y1) of dst from src.
+    static void halveRect(const uint8_t *src, int sw, int sh, uint8_t *dst, int dw, int x0, int x1, int y0, int y1,
+                          bool srgb, Kernel kernel) {
+        for (int y = y0; y < y1; y++) {
+            const uint8_t *a = src + (size_t)(2 * y) * sw * 4;
+            const uint8_t *b = src + (size_t)std::min(2 * y + 1, sh - 1) * sw * 4;
+            uint8_t *out = dst + (size_t)y * dw * 4;
+            if (kernel == AVX2)
+                rowAvx2(a, b, out, x0, x1 - x0, sw, srgb);
+            else if (kernel == SSE2)
+                rowSse2(a, b, out, x0, x1 - x0, sw, srgb);
+            else
+                rowScalar(a, b, out, x0, x1 - x0, sw, srgb);
+        }
+    }
+
+    const uint8_t *levelData(const uint8_t *source, int level) const {
+        return level ? pixels.data() + levels[level].offset : source;
+    }
+
+  public:
+    // Fastest kernel this CPU runs.
+    static Kernel bestKernel() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return AVX2;
+        return __builtin_cpu_supports("sse2") ? SSE2 : SCALAR;
+    }
+
+    static const char *kernelName(Kernel k) { return k == AVX2 ? "avx2" : k == SSE2 ? "sse2" : "scalar"; }
+
+    // Number of levels of a full chain, as glTexStorage expects.
+    static int levelCount(int width, int height) {
+        int n = 1;
+        while ((std::max(width, height) >> n) > 0)
+            n++;
+        return n;
+    }
+
+    // One level down from a w x h image, into dst (max(1, w/2) x max(1, h/2)).
+    static void halve(const unsigned char *src, int w, int h, unsigned char *dst, bool srgb = true) {
+        int dw = std::max(1, w / 2), dh = std::max(1, h / 2);
+        halveRect(src, w, h, dst, dw, 0, dw, 0, dh, srgb, bestKernel());
+    }
+
+    // Builds every level below the w x h source, which must stay alive
+    // while levels are read through data(0). threads <= 0 uses one per core.
+    void build(const unsigned char *source, int w, int h, bool srgb = true, int threads = 0,
+               Kernel kernel = bestKernel()) {
+        int count = levelCount(w, h);
+        levels.assign(1, Level{w, h, 0});
+        size_t size = 0;
+        for (int l = 1; l < count; l++) {
+            const Level &up = levels.back();
+            levels.push_back({std::max(1, up.width / 2), std::max(1, up.height / 2), size});
+            size += (size_t)levels.back().width * levels.back().height * 4;
+        }
+        pixels.resize(size);
+
+        // Whole tiles down to level tileLevels, in parallel
+        int tileLevels = std::min(count - 1, TILE_LEVELS);
+        int tilesX = (w + TILE - 1) / TILE, tilesY = (h + TILE - 1) / TILE;
+        int tiles = tilesX * tilesY;
+        std::atomic<int> next(0);
+        auto work = [&] {
+            for (int tile = next++; tile < tiles; tile = next++) {
+                int tx = tile % tilesX, ty = tile / tilesX;
+                for (int l = 1; l <= tileLevels; l++) {
+                    const Level &up = levels[l - 1], &dst = levels[l];
+                    int span = TILE >> l;
+                    int x0 = tx * span, y0 = ty * span;
+                    int x1 = std::min(x0 + span, dst.width), y1 = std::min(y0 + span, dst.height);
+                    if (x0 >= x1 || y0 >= y1)
+                        break;
+                    halveRect(levelData(source, l - 1), up.width, up.height, pixels.data() + dst.offset, dst.width,
+                              x0, x1, y0, y1, srgb, kernel);
+                }
+            }
+        };
+        if (threads <= 0)
+            threads = std::max(1, (int)std::thread::hardware_concurrency());
+        threads = std::min(threads, tiles);
+        std::vector<std::thread> workers;
+        for (int i = 1; i < threads; i++)
+            workers.emplace_back(work);
+        work();
+        for (auto &t : workers)
+            t.join();
+
+        // The remaining levels are at most (w / TILE) x (h / TILE)
+        for (int l = tileLevels + 1; l < count; l++) {
+            const Level &up = levels[l - 1], &dst = levels[l];
+            halveRect(levelData(source, l - 1), up.width, up.height, pixels.data() + dst.offset, dst.width, 0,
+                      dst.width, 0, dst.height, srgb, kernel);
+        }
+    }
+
+    int count() const { return (int)levels.size(); }
+    const Level &level(int l) const { return levels[l]; }
+    // Texels of level l >= 1
+    const unsigned char *data(int l) const { return pixels.data() + levels[l].offset; }
+    size_t bytes() const { return pixels.size(); }
+};
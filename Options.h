@@ -0,0 +1,103 @@
+#pragma once
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Command line options of the demo:
+//   spg [--instances N] [--mesh model.smesh] [--animate] [--threads N]
+//       [--post tonemap,blur,fxaa] [--overlay] [--trace trace.json]
+//       [--bench N [--size WxH] [--png out.png] [--csv frames.csv]]
+//   spg --cook | --cook-rgba
+//   spg --import-mesh model.obj|model.ply out.smesh
+//   spg --bench-mips [image]
+struct Options {
+    int instances = 1; // triangles drawn with one instanced draw call
+    std::string mesh;  // .smesh drawn instead of the triangle
+    bool animate = false; // spin every instance
+    int threads = 0;      // frame preparation threads, 0 = one per core
+    std::string post;     // post-process chain, empty = render straight to the window
+    bool overlay = false; // frame statistics on screen ('o' toggles)
+    std::string trace;    // Chrome trace written on exit ('t' writes it now)
+
+    // Offscreen benchmark
+    int frames = 0; // 0 = interactive GLUT mode
+    int width = 800, height = 600;
+    std::string png; // dump of the last frame
+    std::string csv; // per-frame timings
+
+    // Offline texture cooking
+    bool cook = false;
+    bool cookCompressed = true; // false = raw RGBA8
+
+    // Offline mesh import
+    std::string importSource, importDestination;
+
+    // CPU mip chain against glGenerateMipmap
+    bool benchMips = false;
+    std::string mipImage; // empty = a generated 4096x4096 image
+
+    // Returns false on malformed arguments: unknown flags, flags missing
+    // their value and out-of-range numbers. The X11 options glutInit()
+    // takes later are let through.
+    bool parse(int argc, char **argv) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--instances" && hasValue)
+                instances = atoi(argv[++i]);
+            else if (arg == "--mesh" && hasValue)
+                mesh = argv[++i];
+            else if (arg == "--animate")
+                animate = true;
+            else if (arg == "--threads" && hasValue)
+                threads = atoi(argv[++i]);
+            else if (arg == "--post" && hasValue)
+                post = argv[++i];
+            else if (arg == "--import-mesh" && i + 2 < argc) {
+                importSource = argv[++i];
+                importDestination = argv[++i];
+            } else if (arg == "--overlay")
+                overlay = true;
+            else if (arg == "--trace" && hasValue)
+                trace = argv[++i];
+            else if (arg == "--bench" && hasValue)
+                frames = atoi(argv[++i]);
+            else if (arg == "--size" && hasValue) {
+                if (sscanf(argv[++i], "%dx%d", &width, &height) != 2)
+                    return false;
+            } else if (arg == "--png" && hasValue)
+                png = argv[++i];
+            else if (arg == "--csv" && hasValue)
+                csv = argv[++i];
+            else if (arg == "--cook")
+                cook = true;
+            else if (arg == "--cook-rgba")
+                cook = true, cookCompressed = false;
+            else if (arg == "--bench-mips") {
+                benchMips = true;
+                if (hasValue && argv[i + 1][0] != '-')
+                    mipImage = argv[++i];
+            } else if ((arg == "-display" || arg == "-geometry") && hasValue)
+                i++;
+            else if (arg != "-iconic" && arg != "-direct" && arg != "-indirect" && arg != "-gldebug" &&
+                     arg != "-sync") {
+                if (arg[0] == '-')
+                    std::cout << "Unknown option or missing value: " << arg << std::endl;
+                else
+                    std::cout << "Unexpected argument: " << arg << std::endl;
+                return false;
+            }
+        }
+        return instances > 0 && frames >= 0 && width > 0 && height > 0 && threads >= 0;
+    }
+
+    static void usage() {
+        std::cout << "usage: spg [--instances N] [--mesh model.smesh] [--animate] [--threads N]\n"
+                  << "           [--post tonemap,blur,fxaa] [--overlay] [--trace trace.json]\n"
+                  << "           [--bench N [--size WxH] [--png out.png] [--csv frames.csv]]\n"
+                  << "       spg --cook | --cook-rgba\n"
+                  << "       spg --import-mesh model.obj|model.ply out.smesh\n"
+                  << "       spg --bench-mips [image]" << std::endl;
+    }
+};
@@ -0,0 +1,254 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+
+#include "ShaderProgram.h"
+
+// Offscreen colour (or depth) textures with their framebuffers, recycled by
+// size and format. Targets that have not been used for maxAge frames are
+// deleted by collect().
+class RenderTargetPool {
+  public:
+    struct Target {
+        GLuint texture, fbo;
+        int width, height;
+        GLenum format;
+        unsigned lastUsed;
+        bool inUse;
+    };
+
+  private:
+    std::vector<std::unique_ptr<Target>> targets;
+
+    static bool isDepth(GLenum format) {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+    }
+
+    static void destroy(Target &t) {
+        glDeleteFramebuffers(1, &t.fbo);
+        glDeleteTextures(1, &t.texture);
+    }
+
+  public:
+    RenderTargetPool() {}
+    ~RenderTargetPool() {
+        for (auto &t : targets)
+            destroy(*t);
+    }
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    // A free target of that size and format, created if there is none.
+    Target *acquire(int width, int height, GLenum format, unsigned frame) {
+        for (auto &t : targets)
+            if (!t->inUse && t->width == width && t->height == height && t->format == format) {
+                t->inUse = true;
+                t->lastUsed = frame;
+                return t.get();
+            }
+
+        std::unique_ptr<Target> t(new Target{0, 0, width, height, format, frame, true});
+        glGenTextures(1, &t->texture);
+        glBindTexture(GL_TEXTURE_2D, t->texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &t->fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, t->fbo);
+        if (isDepth(format)) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, t->texture, 0);
+            glDrawBuffer(GL_NONE);
+        } else
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, t->texture, 0);
+        targets.push_back(std::move(t));
+        return targets.back().get();
+    }
+
+    void release(Target *t) { t->inUse = false; }
+
+    // Deletes free targets last used more than maxAge frames ago.
+    void collect(unsigned frame, unsigned maxAge) {
+        for (size_t i = 0; i < targets.size();) {
+            Target &t = *targets[i];
+            if (!t.inUse && frame - t.lastUsed > maxAge) {
+                destroy(t);
+                targets.erase(targets.begin() + i);
+            } else
+                i++;
+        }
+    }
+
+    size_t size() const { return targets.size(); }
+};
+
+// Renders the scene into an HDR target and runs it through a chain of
+// fullscreen passes, e.g. "tonemap,blur,fxaa"; the last pass writes to the
+// output framebuffer. Every pass samples the previous result from
+// "source" on unit 0 and gets the size of one texel in "texelSize".
+//
+// Targets are sized up to a multiple of BUCKET and the frame only covers
+// their lower left corner (the viewport is left at the window size), so a
+// window being resized reuses the same targets until it crosses a bucket.
+// "uvScale" maps the fullscreen triangle onto that corner and "uvMax" is
+// the last texel centre in it, so taps clamp there instead of reading the
+// unused part.
+class PostProcess {
+    struct Pass {
+        std::unique_ptr<ShaderProgram> program;
+        glm::vec2 direction; // blur only
+        bool tonemap;        // output is LDR from here on
+        int source, texelSize, directionUniform, exposure, uvScale, uvMax;
+    };
+
+    static const int BUCKET = 256;
+
+    // Unused targets (from buckets the window has left) are kept this many
+    // frames
+    static const unsigned MAX_AGE = 120;
+
+    std::vector<Pass> passes;
+    RenderTargetPool pool;
+    RenderTargetPool::Target *color, *depth;
+    GLuint vao;
+    int width, height;             // of the output
+    int targetWidth, targetHeight; // rounded up to BUCKET
+    unsigned frame;
+
+    static int bucket(int size) { return (std::max(size, 1) + BUCKET - 1) / BUCKET * BUCKET; }
+
+    static std::string read(const std::string &path) {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    bool addPass(const std::string &vertex, const std::string &fragmentFile, ProgramCache *cache,
+                 const glm::vec2 &direction) {
+        Pass pass;
+        pass.program.reset(new ShaderProgram());
+        if (!pass.program->build(vertex, read(fragmentFile), cache)) {
+            std::cout << "Failed to build post-process pass " << fragmentFile << std::endl;
+            return false;
+        }
+        pass.direction = direction;
+        pass.tonemap = fragmentFile == "tonemap.frag";
+        pass.source = pass.program->uniform("source");
+        pass.texelSize = pass.program->uniform("texelSize");
+        pass.directionUniform = pass.program->uniform("direction");
+        pass.exposure = pass.program->uniform("exposure");
+        pass.uvScale = pass.program->uniform("uvScale");
+        pass.uvMax = pass.program->uniform("uvMax");
+        pass.program->use();
+        pass.program->set(pass.source, 0);
+        pass.program->set(pass.exposure, 1.0f);
+        passes.push_back(std::move(pass));
+        return true;
+    }
+
+  public:
+    PostProcess()
+        : color(NULL), depth(NULL), vao(0), width(0), height(0), targetWidth(0), targetHeight(0), frame(0) {}
+    ~PostProcess() {
+        if (vao)
+            glDeleteVertexArrays(1, &vao);
+    }
+    PostProcess(const PostProcess &) = delete;
+    PostProcess &operator=(const PostProcess &) = delete;
+
+    // Builds the passes of a comma-separated chain of tonemap, blur (a
+    // horizontal and a vertical pass) and fxaa. An empty chain disables
+    // post-processing.
+    bool create(const std::string &chain, ProgramCache *cache = NULL) {
+        std::string vertex = read("fullscreen.vert");
+        std::stringstream names(chain);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            bool ok;
+            if (name == "blur")
+                ok = addPass(vertex, "blur.frag", cache, glm::vec2(1.0f, 0.0f)) &&
+                     addPass(vertex, "blur.frag", cache, glm::vec2(0.0f, 1.0f));
+            else if (name == "tonemap" || name == "fxaa")
+                ok = addPass(vertex, name + ".frag", cache, glm::vec2(0.0f));
+            else {
+                std::cout << "Unknown post-process pass " << name << std::endl;
+                ok = false;
+            }
+            if (!ok) {
+                passes.clear();
+                return false;
+            }
+        }
+        // The fullscreen triangle is generated from gl_VertexID
+        glGenVertexArrays(1, &vao);
+        return true;
+    }
+
+    bool enabled() const { return !passes.empty(); }
+
+    // Size of the output and of the viewport; targets of other buckets age
+    // out of the pool.
+    void resize(int w, int h) {
+        width = w;
+        height = h;
+        targetWidth = bucket(w);
+        targetHeight = bucket(h);
+    }
+
+    // Binds the HDR scene target; draw the scene after this.
+    void begin() {
+        color = pool.acquire(targetWidth, targetHeight, GL_RGBA16F, frame);
+        depth = pool.acquire(targetWidth, targetHeight, GL_DEPTH_COMPONENT24, frame);
+        glBindFramebuffer(GL_FRAMEBUFFER, color->fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth->texture, 0);
+    }
+
+    // Runs the chain, the last pass into output (0 = the window).
+    void end(GLuint output) {
+        pool.release(depth);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(vao);
+        glActiveTexture(GL_TEXTURE0);
+
+        RenderTargetPool::Target *source = color;
+        bool hdr = true;
+        glm::vec2 texel(1.0f / targetWidth, 1.0f / targetHeight);
+        glm::vec2 uvScale(width * texel.x, height * texel.y);
+        glm::vec2 uvMax(uvScale - 0.5f * texel);
+        for (size_t i = 0; i < passes.size(); i++) {
+            Pass &pass = passes[i];
+            hdr = hdr && !pass.tonemap;
+            RenderTargetPool::Target *target = NULL;
+            if (i + 1 < passes.size()) {
+                target = pool.acquire(targetWidth, targetHeight, hdr ? GL_RGBA16F : GL_RGBA8, frame);
+                glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+            } else
+                glBindFramebuffer(GL_FRAMEBUFFER, output);
+
+            pass.program->use();
+            pass.program->set(pass.texelSize, texel);
+            pass.program->set(pass.directionUniform, pass.direction);
+            pass.program->set(pass.uvScale, uvScale);
+            pass.program->set(pass.uvMax, uvMax);
+            glBindTexture(GL_TEXTURE_2D, source->texture);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+
+            pool.release(source);
+            source = target;
+        }
+
+        glEnable(GL_DEPTH_TEST);
+        pool.collect(++frame, MAX_AGE);
+    }
+
+    size_t pooledTargets() const { return pool.size(); }
+};
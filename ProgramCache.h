@@ -0,0 +1,146 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Persistent on-disk cache of linked programs (glGetProgramBinary /
+// glProgramBinary). Entries are keyed by a hash of the shader sources and
+// the GL vendor, renderer and version strings, so a driver update or a
+// different GPU simply misses instead of loading an incompatible binary.
+class ProgramCache {
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t format; // binaryFormat reported by the driver
+        uint32_t length;
+    };
+
+    static constexpr uint32_t fileVersion = 1;
+
+    std::string dir;
+    bool enabled;
+
+    // 64-bit FNV-1a
+    static uint64_t hash(uint64_t h, const std::string &text) {
+        for (unsigned char c : text) {
+            h ^= c;
+            h *= 0x100000001b3ull;
+        }
+        // separator, so ("ab", "c") and ("a", "bc") differ
+        h ^= 0xff;
+        h *= 0x100000001b3ull;
+        return h;
+    }
+
+    std::string path(const std::string &key) const { return dir + "/" + key + ".bin"; }
+
+  public:
+    ProgramCache(const std::string &dir = ".shader_cache") : dir(dir), enabled(false) {}
+
+    // Must be called with a current context; disables the cache if the driver
+    // offers no binary formats.
+    void init() {
+        GLint formats = 0;
+        if (GLEW_ARB_get_program_binary)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        enabled = formats > 0;
+        if (enabled) {
+            std::error_code ec;
+            std::filesystem::create_directories(dir, ec);
+            enabled = !ec;
+        }
+    }
+
+    bool isEnabled() const { return enabled; }
+
+    std::string key(const std::vector<std::string> &sources) const {
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (auto &source : sources)
+            h = hash(h, source);
+        h = hash(h, (const char *)glGetString(GL_VENDOR));
+        h = hash(h, (const char *)glGetString(GL_RENDERER));
+        h = hash(h, (const char *)glGetString(GL_VERSION));
+
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", (unsigned long long)h);
+        return text;
+    }
+
+    // Returns a linked program, or 0 if the entry is missing or the driver
+    // rejected it (stale entries are removed).
+    GLuint load(const std::string &key) {
+        if (!enabled)
+            return 0;
+
+        std::ifstream file(path(key), std::ios::binary);
+        if (!file)
+            return 0;
+
+        // The length must account for exactly the rest of the file, so a
+        // truncated or corrupt entry is a miss rather than a huge allocation
+        std::error_code ec;
+        uintmax_t size = std::filesystem::file_size(path(key), ec);
+        Header header;
+        std::vector<char> binary;
+        if (file.read((char *)&header, sizeof(header)) &&
+            std::string(header.magic, 4) == "SPGB" && header.version == fileVersion && !ec &&
+            header.length == size - sizeof(header)) {
+            binary.resize(header.length);
+            file.read(binary.data(), header.length);
+        }
+        if (binary.empty() || !file) {
+            std::filesystem::remove(path(key));
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, binary.data(), header.length);
+
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glDeleteProgram(program);
+            std::filesystem::remove(path(key));
+            return 0;
+        }
+        return program;
+    }
+
+    // Stores a linked program. The program must have been linked with
+    // GL_PROGRAM_BINARY_RETRIEVABLE_HINT set.
+    void store(const std::string &key, GLuint program) {
+        if (!enabled)
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        Header header = {{'S', 'P', 'G', 'B'}, fileVersion, format, (uint32_t)length};
+
+        // Write to a temporary file and rename, so a crash never leaves a
+        // truncated entry behind
+        std::string tmp = path(key) + ".tmp";
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            file.write((const char *)&header, sizeof(header));
+            file.write(binary.data(), length);
+            if (!file) {
+                std::cout << "Failed to write program cache entry " << tmp << std::endl;
+                return;
+            }
+        }
+        std::error_code ec;
+        std::filesystem::rename(tmp, path(key), ec);
+    }
+};
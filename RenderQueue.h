@@ -0,0 +1,198 @@
+#pragma once
+#include <GL/glew.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "SceneGraph.h"
+#include "WorkerPool.h"
+
+// Two-stage frame pipeline. While the GL thread replays the commands of
+// frame N, a preparation thread animates, updates and culls the scene for
+// frame N+1, with the heavy loops split over a pool of worker threads, and
+// records the result into the other of two Frame slots. The GL thread never
+// touches the scene graph between start() and stop(), and stop() has to be
+// called before anything the animation reads is destroyed.
+//
+// The handoff is not lock-free: kick() and acquire() each take a mutex for a
+// few assignments, and the slots themselves are never copied or locked. The
+// GL thread has to block until its frame is ready and idle threads should
+// sleep rather than spin, which needs a condition variable in C++17 (there
+// is no std::atomic::wait), so a lock-free queue would only move the wait.
+//
+// Usage on the GL thread, once per frame:
+//   Frame &frame = queue.acquire(viewProjection, t); // waits for the frame kicked last time
+//   queue.kick(viewProjection, t);                   // prepare the next one meanwhile
+//   ... upload frame.instances if frame.upload, replay frame.commands ...
+class RenderQueue {
+  public:
+    enum Op { USE_PROGRAM, BIND_MATERIAL, BIND_VERTEX_ARRAY, DRAW };
+
+    struct Command {
+        Op op;
+        SceneGraph::Drawable state; // program / material / vao / geometry
+        int firstInstance, instanceCount;
+    };
+
+    struct Frame {
+        glm::mat4 viewProjection; // the one the frame was culled with
+        std::vector<SceneGraph::Instance> instances;
+        std::vector<Command> commands;
+        bool upload; // false: instances are unchanged since the previous frame and not filled in
+    };
+
+    // Called on worker threads with disjoint ranges of [0, count) and the
+    // time passed to kick(); typically moves nodes with SceneGraph::setLocal
+    typedef std::function<void(size_t begin, size_t end, double time)> Animation;
+
+  private:
+    SceneGraph *scene;
+    Animation animation;
+    size_t animationCount;
+
+    Frame frames[2];
+    std::vector<SceneGraph::Batch> batches;
+    int current; // slot returned by the last acquire()
+
+    // Preparation thread
+    std::thread prepThread;
+    std::mutex mutex;
+    std::condition_variable wake, prepared;
+    bool requested, ready, stopping;
+    glm::mat4 requestViewProjection;
+    double requestTime;
+    int requestSlot;
+
+    // Splits the heavy loops of the preparation thread; ranges of up to
+    // 1024 items are not worth waking the workers for
+    WorkerPool pool;
+
+    struct ParallelFor {
+        WorkerPool *pool;
+        template <class Fn> void operator()(size_t count, const Fn &fn) const {
+            std::function<void(size_t, size_t)> f = fn;
+            pool->parallelFor(count, f);
+        }
+    };
+
+    void prepare(Frame &frame, const Frame &previous, const glm::mat4 &viewProjection, double time) {
+        if (animation)
+            pool.parallelFor(animationCount, [&](size_t begin, size_t end) { animation(begin, end, time); });
+
+        frame.viewProjection = viewProjection;
+        frame.upload = scene->prepare(viewProjection, frame.instances, batches, ParallelFor{&pool});
+        if (!frame.upload) {
+            frame.commands = previous.commands;
+            return;
+        }
+
+        // Record a bind only where the sorted batches switch state
+        frame.commands.clear();
+        int program = -1, material = -1;
+        GLuint vao = 0;
+        for (const SceneGraph::Batch &batch : batches) {
+            const SceneGraph::Drawable &d = batch.state;
+            if (d.program != program)
+                frame.commands.push_back({USE_PROGRAM, d, 0, 0});
+            if (d.material != material)
+                frame.commands.push_back({BIND_MATERIAL, d, 0, 0});
+            if (d.vao != vao)
+                frame.commands.push_back({BIND_VERTEX_ARRAY, d, 0, 0});
+            frame.commands.push_back({DRAW, d, batch.firstInstance, batch.instanceCount});
+            program = d.program;
+            material = d.material;
+            vao = d.vao;
+        }
+    }
+
+    void run() {
+        for (;;) {
+            glm::mat4 viewProjection;
+            double time;
+            int slot;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || requested; });
+                if (stopping)
+                    return;
+                viewProjection = requestViewProjection;
+                time = requestTime;
+                slot = requestSlot;
+            }
+            prepare(frames[slot], frames[1 - slot], viewProjection, time);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                requested = false;
+                ready = true;
+            }
+            prepared.notify_all();
+        }
+    }
+
+  public:
+    RenderQueue()
+        : scene(NULL), animationCount(0), current(1), requested(false), ready(false), stopping(false),
+          requestViewProjection(1.0f), requestTime(0), requestSlot(0), pool(1024) {}
+    ~RenderQueue() { stop(); }
+    RenderQueue(const RenderQueue &) = delete;
+    RenderQueue &operator=(const RenderQueue &) = delete;
+
+    // Starts the preparation thread and threads - 1 workers (the preparation
+    // thread takes part in every loop as well); threads <= 0 uses one per core.
+    void start(SceneGraph &graph, int threads = 0) {
+        scene = &graph;
+        pool.start(threads);
+        prepThread = std::thread(&RenderQueue::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        if (prepThread.joinable())
+            prepThread.join();
+        // The preparation thread was the only one handing out jobs
+        pool.stop();
+    }
+
+    // Sets the per-frame animation over count items; call before start().
+    void setAnimation(size_t count, const Animation &fn) {
+        animationCount = count;
+        animation = fn;
+    }
+
+    int threads() const { return pool.threads(); }
+
+    // Starts preparing the frame after the one last acquired.
+    void kick(const glm::mat4 &viewProjection, double time) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requestViewProjection = viewProjection;
+            requestTime = time;
+            requestSlot = 1 - current;
+            requested = true;
+            ready = false;
+        }
+        wake.notify_one();
+    }
+
+    // Waits for the frame kicked last and returns it; it stays valid until
+    // the next acquire(). Kicks one first if nothing is in flight.
+    Frame &acquire(const glm::mat4 &viewProjection, double time) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!requested && !ready) {
+            lock.unlock();
+            kick(viewProjection, time);
+            lock.lock();
+        }
+        prepared.wait(lock, [this] { return ready; });
+        ready = false;
+        current = requestSlot;
+        return frames[current];
+    }
+};
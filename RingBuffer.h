@@ -0,0 +1,145 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+
+// One buffer object split into SECTIONS per-frame sections. Every frame
+// writes its dynamic data (uniform blocks, streamed vertices) into the next
+// section, and a fence marks when the GPU is done with it, so the CPU only
+// ever waits if it gets SECTIONS frames ahead. With ARB_buffer_storage the
+// buffer stays mapped for its whole life (MAP_PERSISTENT | MAP_COHERENT);
+// without it each section is mapped unsynchronised for one frame.
+//
+// Per frame, on the GL thread:
+//   ring.beginFrame(bytes);                       // bytes the frame needs at most
+//   void *p = ring.allocate(n, alignment, offset); // write n bytes to p
+//   ring.flush();                                  // before drawing from it
+//   ... draw ...
+//   ring.endFrame();
+class RingBuffer {
+    static const int SECTIONS = 3;
+
+    // Binding point used to create and map the buffer; not VAO state
+    static const GLenum target = GL_COPY_WRITE_BUFFER;
+
+    GLuint buffer;
+    char *mapped; // whole buffer if persistent, else the current section
+    size_t sectionSize, used;
+    int section;
+    GLsync fences[SECTIONS];
+    unsigned readSections; // other sections read by this frame's commands
+    bool persistent;
+
+    void create(size_t size) {
+        sectionSize = size;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(target, buffer);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(target, sectionSize * SECTIONS, NULL, flags);
+            mapped = (char *)glMapBufferRange(target, 0, sectionSize * SECTIONS, flags);
+        } else
+            glBufferData(target, sectionSize * SECTIONS, NULL, GL_STREAM_DRAW);
+    }
+
+    void destroy() {
+        for (GLsync &f : fences)
+            if (f) {
+                glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(f);
+                f = 0;
+            }
+        if (buffer) {
+            if (mapped) {
+                glBindBuffer(target, buffer);
+                glUnmapBuffer(target);
+            }
+            glDeleteBuffers(1, &buffer);
+        }
+        buffer = 0;
+        mapped = NULL;
+    }
+
+  public:
+    RingBuffer()
+        : buffer(0), mapped(NULL), sectionSize(0), used(0), section(0), fences{},
+          readSections(0), persistent(false) {}
+    ~RingBuffer() { destroy(); }
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // Needs a current context.
+    void init(size_t bytesPerFrame) {
+        persistent = GLEW_ARB_buffer_storage;
+        create(std::max(bytesPerFrame, (size_t)4096));
+    }
+
+    GLuint handle() const { return buffer; }
+    bool isPersistent() const { return persistent; }
+
+    // Moves on to the next section, waiting until the GPU has finished the
+    // frame that used it last. A frame needing more than a section replaces
+    // the buffer with a larger one, so handle() changes.
+    void beginFrame(size_t bytes) {
+        if (bytes > sectionSize) {
+            destroy();
+            create(std::max(bytes, sectionSize * 2));
+            section = 0;
+        } else
+            section = (section + 1) % SECTIONS;
+        used = 0;
+
+        if (GLsync &f = fences[section]) {
+            // Normally long signalled; only a CPU running SECTIONS frames
+            // ahead of the GPU blocks here
+            glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(f);
+            f = 0;
+        }
+        if (!persistent) {
+            glBindBuffer(target, buffer);
+            mapped = (char *)glMapBufferRange(target, section * sectionSize, sectionSize,
+                                              GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                                  GL_MAP_INVALIDATE_RANGE_BIT);
+        }
+    }
+
+    // Reserves bytes in this frame's section, at an offset (from the start
+    // of the buffer) that is a multiple of alignment. Returns where to write
+    // them; NULL if the section is full.
+    void *allocate(size_t bytes, size_t alignment, GLintptr &offset) {
+        size_t base = (size_t)section * sectionSize;
+        size_t start = (base + used + alignment - 1) / alignment * alignment;
+        if (start + bytes > base + sectionSize)
+            return NULL;
+        used = start + bytes - base;
+        offset = (GLintptr)start;
+        return (persistent ? mapped : mapped - base) + start;
+    }
+
+    // Declares that this frame also reads data written by an earlier one at
+    // offset (e.g. copies it forward), so that section is not handed out
+    // again before this frame is done with it.
+    void read(GLintptr offset) { readSections |= 1u << (offset / sectionSize); }
+
+    // Makes this frame's writes visible to GL; coherent mappings need nothing.
+    void flush() {
+        if (!persistent && mapped) {
+            glBindBuffer(target, buffer);
+            glUnmapBuffer(target);
+            mapped = NULL;
+        }
+    }
+
+    // Fences the section (and any it read from) after the last draw using it.
+    void endFrame() {
+        flush();
+        readSections |= 1u << section;
+        for (int s = 0; s < SECTIONS; s++)
+            if (readSections & (1u << s)) {
+                if (fences[s])
+                    glDeleteSync(fences[s]);
+                fences[s] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            }
+        readSections = 0;
+    }
+};
@@ -0,0 +1,242 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// Flat scene graph. Nodes live in one array and a parent is always stored
+// before its children, so world matrices are brought up to date in a single
+// forward pass that only touches dirty nodes and their descendants. Every
+// drawable node carries a local bounding box; its world-space box is cached
+// alongside the world matrix.
+//
+// prepare() culls the drawable nodes against the view frustum, sorts the
+// visible ones by program, material and VAO, and turns every run of nodes
+// with the same state and geometry into one instanced batch. Nothing is
+// redone while neither the camera nor any node has changed.
+//
+// The work can be spread over threads by passing a parallelFor(count, fn)
+// that calls fn(begin, end) on disjoint ranges covering [0, count) and
+// returns when all of them are done (see RenderQueue.h). Nodes are updated
+// one depth level at a time, so a parent is always final before its
+// children read it. setLocal() may be called concurrently for different
+// nodes, but not while prepare() runs.
+class SceneGraph {
+  public:
+    // Per-instance attributes, read with a divisor of 1
+    struct Instance {
+        glm::mat4 model;
+        float layer; // texture array layer, < 0 = split between layers 0 and 1
+    };
+
+    // What a node draws. program and material are indices chosen by the
+    // caller (they only need to be stable, unlike GL names that change when
+    // a shader is reloaded or a texture finishes loading).
+    struct Drawable {
+        uint16_t program, material;
+        GLuint vao; // 0 = group node, nothing to draw
+        GLsizei count;
+        bool indexed; // glDrawElements (GL_UNSIGNED_INT) rather than glDrawArrays
+    };
+
+    // One instanced draw call
+    struct Batch {
+        Drawable state;
+        int firstInstance, instanceCount;
+    };
+
+  private:
+    struct Node {
+        int parent, depth;
+        glm::mat4 local, world;
+        glm::vec3 center, extent; // local bounding box
+        glm::vec3 worldCenter, worldExtent;
+        Drawable drawable;
+        float layer;
+        bool dirty;
+    };
+
+    struct Visible {
+        uint64_t key;
+        int node;
+        bool operator<(const Visible &o) const { return key < o.key || (key == o.key && node < o.node); }
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::vector<int>> levels; // node indices by depth
+    std::vector<char> moved; // scratch for update(): world matrix changed this pass
+    std::vector<Visible> visible;
+    glm::mat4 lastViewProjection;
+    std::atomic<bool> changed;
+
+    // Runs fn over [0, count) on the calling thread
+    struct Serial {
+        template <class Fn> void operator()(size_t count, const Fn &fn) const { fn(0, count); }
+    };
+
+    static uint64_t sortKey(const Drawable &d) {
+        return (uint64_t)d.program << 48 | (uint64_t)d.material << 32 | d.vao;
+    }
+
+    static bool sameBatch(const Drawable &a, const Drawable &b) {
+        return a.program == b.program && a.material == b.material && a.vao == b.vao && a.count == b.count &&
+               a.indexed == b.indexed;
+    }
+
+    // Transformed box as centre + half extents (Arvo's method)
+    static void transformBounds(Node &n) {
+        const glm::mat4 &m = n.world;
+        glm::vec4 c = m[0] * n.center.x + m[1] * n.center.y + m[2] * n.center.z + m[3];
+        n.worldCenter = glm::vec3(c.x, c.y, c.z);
+        for (int i = 0; i < 3; i++)
+            n.worldExtent[i] = std::fabs(m[0][i]) * n.extent.x + std::fabs(m[1][i]) * n.extent.y +
+                               std::fabs(m[2][i]) * n.extent.z;
+    }
+
+  public:
+    SceneGraph() : lastViewProjection(0.0f), changed(true) {}
+    SceneGraph(const SceneGraph &) = delete;
+    SceneGraph &operator=(const SceneGraph &) = delete;
+
+    // Adds a node that only groups and transforms its children.
+    int addGroup(int parent, const glm::mat4 &local) {
+        Drawable none = {0, 0, 0, 0, false};
+        return addDrawable(parent, local, none, glm::vec3(0.0f), glm::vec3(0.0f), 0.0f);
+    }
+
+    // Adds a node drawing d, whose geometry spans [boundsMin, boundsMax] in
+    // the node's local space. parent must already exist (-1 for a root).
+    int addDrawable(int parent, const glm::mat4 &local, const Drawable &d, const glm::vec3 &boundsMin,
+                    const glm::vec3 &boundsMax, float layer) {
+        Node n;
+        n.parent = parent;
+        n.depth = parent >= 0 ? nodes[parent].depth + 1 : 0;
+        n.local = local;
+        n.world = local;
+        n.center = (boundsMin + boundsMax) * 0.5f;
+        n.extent = (boundsMax - boundsMin) * 0.5f;
+        n.drawable = d;
+        n.layer = layer;
+        n.dirty = true;
+        nodes.push_back(n);
+        if ((int)levels.size() <= n.depth)
+            levels.resize(n.depth + 1);
+        levels[n.depth].push_back((int)nodes.size() - 1);
+        changed = true;
+        return (int)nodes.size() - 1;
+    }
+
+    void setLocal(int node, const glm::mat4 &local) {
+        nodes[node].local = local;
+        nodes[node].dirty = true;
+        changed = true;
+    }
+
+    const glm::mat4 &world(int node) const { return nodes[node].world; }
+    size_t size() const { return nodes.size(); }
+
+    // Recomputes the world matrices and boxes of dirty nodes and of every
+    // node below them.
+    template <class ParallelFor = Serial> void update(const ParallelFor &parallelFor = ParallelFor()) {
+        moved.assign(nodes.size(), 0);
+        for (const std::vector<int> &level : levels)
+            parallelFor(level.size(), [&](size_t begin, size_t end) {
+                for (size_t k = begin; k < end; k++) {
+                    int i = level[k];
+                    Node &n = nodes[i];
+                    bool parentMoved = n.parent >= 0 && moved[n.parent];
+                    if (!n.dirty && !parentMoved)
+                        continue;
+                    n.world = n.parent >= 0 ? nodes[n.parent].world * n.local : n.local;
+                    if (n.drawable.vao)
+                        transformBounds(n);
+                    n.dirty = false;
+                    moved[i] = 1;
+                }
+            });
+    }
+
+    // Updates, culls and sorts the scene for viewProjection, filling
+    // instances (in draw order) and batches. Returns false, leaving both
+    // untouched, when nothing changed since the last call.
+    template <class ParallelFor = Serial>
+    bool prepare(const glm::mat4 &viewProjection, std::vector<Instance> &instances, std::vector<Batch> &batches,
+                 const ParallelFor &parallelFor = ParallelFor()) {
+        if (!changed && viewProjection == lastViewProjection)
+            return false;
+        changed = false;
+        update(parallelFor);
+
+        // Frustum planes straight from the matrix (Gribb & Hartmann): rows
+        // 3 +/- 0, 1, 2 give left/right, bottom/top, near/far
+        const glm::mat4 &m = viewProjection;
+        glm::vec4 planes[6];
+        for (int axis = 0; axis < 3; axis++)
+            for (int side = 0; side < 2; side++) {
+                float s = side ? -1.0f : 1.0f;
+                glm::vec4 &p = planes[axis * 2 + side];
+                for (int c = 0; c < 4; c++)
+                    p[c] = m[c][3] + s * m[c][axis];
+            }
+
+        // Each range collects its visible nodes locally and reserves room in
+        // the shared list with one atomic add per block
+        visible.resize(nodes.size());
+        std::atomic<size_t> visibleCount(0);
+        parallelFor(nodes.size(), [&](size_t begin, size_t end) {
+            const size_t BLOCK = 256;
+            Visible found[BLOCK];
+            size_t count = 0;
+            auto flush = [&] {
+                size_t slot = visibleCount.fetch_add(count);
+                std::copy(found, found + count, visible.begin() + slot);
+                count = 0;
+            };
+            for (size_t i = begin; i < end; i++) {
+                const Node &n = nodes[i];
+                if (!n.drawable.vao)
+                    continue;
+                bool inside = true;
+                for (int p = 0; p < 6 && inside; p++) {
+                    const glm::vec4 &pl = planes[p];
+                    float distance = pl.x * n.worldCenter.x + pl.y * n.worldCenter.y + pl.z * n.worldCenter.z + pl.w;
+                    float radius = std::fabs(pl.x) * n.worldExtent.x + std::fabs(pl.y) * n.worldExtent.y +
+                                   std::fabs(pl.z) * n.worldExtent.z;
+                    inside = distance >= -radius;
+                }
+                if (inside)
+                    found[count++] = {sortKey(n.drawable), (int)i};
+                if (count == BLOCK)
+                    flush();
+            }
+            if (count)
+                flush();
+        });
+        visible.resize(visibleCount);
+        std::sort(visible.begin(), visible.end());
+
+        batches.clear();
+        for (size_t i = 0; i < visible.size(); i++) {
+            const Drawable &d = nodes[visible[i].node].drawable;
+            if (batches.empty() || !sameBatch(batches.back().state, d))
+                batches.push_back({d, (int)i, 0});
+            batches.back().instanceCount++;
+        }
+        instances.resize(visible.size());
+        parallelFor(visible.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const Node &n = nodes[visible[i].node];
+                instances[i].model = n.world;
+                instances[i].layer = n.layer;
+            }
+        });
+
+        lastViewProjection = viewProjection;
+        return true;
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glm/vec2.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "ProgramCache.h"
+
+// Wraps a linked GLSL program. All active uniforms are resolved once after
+// linking into a name -> location table, and every setter keeps a shadow copy
+// of the last value so a uniform is only re-uploaded when it actually changes.
+// Setters use glUniform*, so the program must be bound with use() first.
+class ShaderProgram {
+    struct Uniform {
+        GLint location;
+        GLenum type;
+        GLint size;
+        std::vector<unsigned char> value; // last uploaded value, empty if never set
+    };
+
+    GLuint id;
+    std::vector<Uniform> uniforms;
+    std::unordered_map<std::string, int> names; // uniform name -> index in uniforms
+
+    static GLuint compile(GLenum type, const std::string &source, const char *label) {
+        const char *text = source.c_str();
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &text, NULL);
+        glCompileShader(shader);
+
+        int success;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cout << label << " shader compilation failed:\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+
+    // Returns true if the bytes differ from the shadow copy (and updates it).
+    bool changed(int handle, const void *data, size_t bytes) {
+        if (handle < 0 || handle >= (int)uniforms.size())
+            return false;
+        std::vector<unsigned char> &value = uniforms[handle].value;
+        if (value.size() == bytes && memcmp(value.data(), data, bytes) == 0)
+            return false;
+        value.assign((const unsigned char *)data, (const unsigned char *)data + bytes);
+        return true;
+    }
+
+  public:
+    ShaderProgram() : id(0) {}
+    ~ShaderProgram() {
+        if (id)
+            glDeleteProgram(id);
+    }
+    ShaderProgram(const ShaderProgram &) = delete;
+    ShaderProgram &operator=(const ShaderProgram &) = delete;
+
+    GLuint handle() const { return id; }
+
+    // Compiles and links the two stages into a new program, 0 on failure
+    // (the logs are printed). Only needs a current context, so it can also
+    // run on a background context shared with the rendering one.
+    static GLuint link(const std::string &vertexSource, const std::string &fragmentSource,
+                       bool retrievable = false) {
+        GLuint vs = compile(GL_VERTEX_SHADER, vertexSource, "Vertex");
+        GLuint fs = compile(GL_FRAGMENT_SHADER, fragmentSource, "Fragment");
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        if (retrievable)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(program);
+        glDetachShader(program, vs);
+        glDetachShader(program, fs);
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+
+        int success;
+        char infoLog[512];
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "Shader program linking failed:\n" << infoLog << std::endl;
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    // Compiles and links the two stages, then resolves the uniform table.
+    // With a cache, a previously stored binary is tried first and a freshly
+    // linked program is stored for the next run.
+    bool build(const std::string &vertexSource, const std::string &fragmentSource,
+               ProgramCache *cache = NULL) {
+        std::string key;
+        if (cache && cache->isEnabled()) {
+            key = cache->key({vertexSource, fragmentSource});
+            if (GLuint cached = cache->load(key)) {
+                adopt(cached);
+                return true;
+            }
+        }
+
+        GLuint program = link(vertexSource, fragmentSource, !key.empty());
+        if (!program)
+            return false;
+
+        if (!key.empty())
+            cache->store(key, program);
+        adopt(program);
+        return true;
+    }
+
+    // Takes ownership of an already linked program.
+    void adopt(GLuint program) {
+        if (id)
+            glDeleteProgram(id);
+        id = program;
+        resolveUniforms();
+    }
+
+    // Queries every active uniform once. Array uniforms are registered both
+    // as "name[0]" (as reported by the driver) and as plain "name".
+    void resolveUniforms() {
+        uniforms.clear();
+        names.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<char> name(maxLength > 0 ? maxLength : 1);
+
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            Uniform u;
+            glGetActiveUniform(id, i, (GLsizei)name.size(), &length, &u.size, &u.type, name.data());
+            std::string uniformName(name.data(), length);
+            u.location = glGetUniformLocation(id, uniformName.c_str());
+            if (u.location < 0)
+                continue; // uniform block members have no location
+
+            names[uniformName] = (int)uniforms.size();
+            size_t bracket = uniformName.find("[0]");
+            if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+                names[uniformName.substr(0, bracket)] = (int)uniforms.size();
+            uniforms.push_back(u);
+        }
+    }
+
+    // Handle for the setters below, -1 if the uniform is not active.
+    int uniform(const std::string &name) const {
+        auto it = names.find(name);
+        return it == names.end() ? -1 : it->second;
+    }
+
+    void use() const { glUseProgram(id); }
+
+    // Attaches a uniform block to a binding point (see glBindBufferRange).
+    void bindBlock(const std::string &name, GLuint binding) {
+        GLuint index = glGetUniformBlockIndex(id, name.c_str());
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(id, index, binding);
+    }
+
+    void set(int handle, int v) {
+        if (changed(handle, &v, sizeof(v)))
+            glUniform1i(uniforms[handle].location, v);
+    }
+    void set(int handle, float v) {
+        if (changed(handle, &v, sizeof(v)))
+            glUniform1f(uniforms[handle].location, v);
+    }
+    void set(int handle, const glm::vec2 &v) {
+        if (changed(handle, glm::value_ptr(v), sizeof(float) * 2))
+            glUniform2fv(uniforms[handle].location, 1, glm::value_ptr(v));
+    }
+    void set(int handle, const glm::mat4 &m) {
+        if (changed(handle, glm::value_ptr(m), sizeof(float) * 16))
+            glUniformMatrix4fv(uniforms[handle].location, 1, GL_FALSE, glm::value_ptr(m));
+    }
+    void set(int handle, const std::vector<glm::vec2> &v) {
+        if (!v.empty() && changed(handle, v.data(), sizeof(glm::vec2) * v.size()))
+            glUniform2fv(uniforms[handle].location, (GLsizei)v.size(), glm::value_ptr(v[0]));
+    }
+
+    template <typename T> void set(const std::string &name, const T &v) { set(uniform(name), v); }
+};
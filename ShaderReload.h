@@ -0,0 +1,223 @@
+#pragma once
+#include <GL/glew.h>
+#include <GL/glx.h>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "ShaderProgram.h"
+
+// Watches the shader files with inotify and rebuilds the program whenever one
+// of them is saved. The build runs on a worker thread with its own GLX
+// context sharing objects with the window's, so the render loop never waits
+// for the driver's compiler; the finished program is picked up between
+// frames with poll() once its fence has signalled. A program that fails to
+// build is reported and the old one is kept.
+//
+// Without a shared context (no GLX, no pbuffer support) the worker only
+// watches the files and poll() builds the program on the calling thread.
+// XInitThreads() must have been called before GLUT opened the display.
+class ShaderReloader {
+    std::string vertexPath, fragmentPath;
+    int inotifyFd;
+    std::thread worker;
+    std::atomic<bool> quit;
+
+    // Background context
+    Display *display;
+    GLXContext context;
+    GLXPbuffer pbuffer;
+
+    // Results handed to the render thread
+    std::mutex mutex;
+    GLuint program; // linked on the worker, waiting for its fence
+    GLsync fence;
+    bool sourcesChanged; // fallback: build on the render thread
+
+    static std::string read(const std::string &path) {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    static std::string fileName(const std::string &path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    static std::string directory(const std::string &path) {
+        size_t slash = path.find_last_of('/');
+        return slash == std::string::npos ? "." : path.substr(0, slash);
+    }
+
+    // Creates a 1x1 pbuffer and a context sharing with the current one.
+    bool createSharedContext() {
+        GLXContext share = glXGetCurrentContext();
+        display = glXGetCurrentDisplay();
+        if (!share || !display)
+            return false;
+
+        int configId = 0;
+        glXQueryContext(display, share, GLX_FBCONFIG_ID, &configId);
+        const int configAttribs[] = {GLX_FBCONFIG_ID, configId, None};
+        int count = 0;
+        GLXFBConfig *configs = glXChooseFBConfig(display, DefaultScreen(display), configAttribs, &count);
+        if (!configs || !count)
+            return false;
+        const int pbufferAttribs[] = {GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None};
+        pbuffer = glXCreatePbuffer(display, configs[0], pbufferAttribs);
+        context = glXCreateNewContext(display, configs[0], GLX_RGBA_TYPE, share, True);
+        XFree(configs);
+        if (!pbuffer || !context) {
+            destroySharedContext();
+            return false;
+        }
+        return true;
+    }
+
+    void destroySharedContext() {
+        if (context)
+            glXDestroyContext(display, context);
+        if (pbuffer)
+            glXDestroyPbuffer(display, pbuffer);
+        context = NULL;
+        pbuffer = 0;
+    }
+
+    // Blocks until one of the watched files was written, or quit is set.
+    bool waitForChange() {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        pollfd fd = {inotifyFd, POLLIN, 0};
+        while (!quit) {
+            if (::poll(&fd, 1, 100) <= 0)
+                continue;
+            bool relevant = false;
+            // Editors often save several times in a row (or write a temporary
+            // file and rename it); drain everything that arrives within 50 ms
+            do {
+                ssize_t length = ::read(inotifyFd, buffer, sizeof(buffer));
+                for (ssize_t i = 0; i < length;) {
+                    const inotify_event *event = (const inotify_event *)(buffer + i);
+                    if (event->len) {
+                        std::string name = event->name;
+                        relevant |= name == fileName(vertexPath) || name == fileName(fragmentPath);
+                    }
+                    i += sizeof(inotify_event) + event->len;
+                }
+            } while (::poll(&fd, 1, 50) > 0);
+            if (relevant)
+                return true;
+        }
+        return false;
+    }
+
+    void run() {
+        if (context)
+            glXMakeContextCurrent(display, pbuffer, pbuffer, context);
+        while (waitForChange()) {
+            if (!context) {
+                std::lock_guard<std::mutex> lock(mutex);
+                sourcesChanged = true;
+                continue;
+            }
+            std::cout << "Rebuilding shaders" << std::endl;
+            GLuint built = ShaderProgram::link(read(vertexPath), read(fragmentPath));
+            if (!built)
+                continue;
+            GLsync done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (program) { // superseded before the render thread took it
+                glDeleteProgram(program);
+                glDeleteSync(fence);
+            }
+            program = built;
+            fence = done;
+        }
+        if (context)
+            glXMakeContextCurrent(display, None, None, NULL);
+    }
+
+  public:
+    ShaderReloader()
+        : inotifyFd(-1), quit(false), display(NULL), context(NULL), pbuffer(0), program(0), fence(0),
+          sourcesChanged(false) {}
+    ~ShaderReloader() { stop(); }
+    ShaderReloader(const ShaderReloader &) = delete;
+    ShaderReloader &operator=(const ShaderReloader &) = delete;
+
+    // Starts watching; call with the window's context current.
+    bool start(const std::string &vertex, const std::string &fragment) {
+        vertexPath = vertex;
+        fragmentPath = fragment;
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0)
+            return false;
+        // Watch the directories, so files replaced by a rename are still seen
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+        bool watching = inotify_add_watch(inotifyFd, directory(vertex).c_str(), mask) >= 0;
+        if (directory(fragment) != directory(vertex))
+            watching |= inotify_add_watch(inotifyFd, directory(fragment).c_str(), mask) >= 0;
+        if (!watching) {
+            ::close(inotifyFd);
+            inotifyFd = -1;
+            return false;
+        }
+        if (!createSharedContext())
+            std::cout << "No shared GL context, shaders will be rebuilt on the render thread" << std::endl;
+        worker = std::thread(&ShaderReloader::run, this);
+        return true;
+    }
+
+    void stop() {
+        quit = true;
+        if (worker.joinable())
+            worker.join();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (program) {
+            glDeleteProgram(program);
+            glDeleteSync(fence);
+            program = 0;
+        }
+        destroySharedContext();
+        if (inotifyFd >= 0)
+            ::close(inotifyFd);
+        inotifyFd = -1;
+    }
+
+    // True if poll() may have something; cheap enough to call from a timer.
+    bool pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return program || sourcesChanged;
+    }
+
+    // Call between frames on the render thread. Returns a new linked program
+    // to adopt, or 0 if nothing is ready yet. Never waits for the GPU.
+    GLuint poll() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (sourcesChanged) {
+            sourcesChanged = false;
+            lock.unlock();
+            std::cout << "Rebuilding shaders" << std::endl;
+            return ShaderProgram::link(read(vertexPath), read(fragmentPath));
+        }
+        if (!program)
+            return 0;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return 0;
+        glDeleteSync(fence);
+        GLuint ready = program;
+        program = 0;
+        fence = 0;
+        return ready;
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glm/vec2.hpp>
+
+#include "CookedTexture.h"
+#include "TextureLoader.h"
+
+// Packs a set of images into the layers of one GL_TEXTURE_2D_ARRAY so a
+// shader can pick a material by layer index instead of switching samplers.
+// Every layer has the size of the largest image; smaller images are padded
+// and layerScale() gives the UV scale that maps [0,1] onto the real image.
+// Layers are streamed in by a TextureLoader; texture() returns a placeholder
+// array until all of them have arrived. If an up-to-date cooked file exists
+// (see CookedTexture.h) it is used instead and no image is decoded at all.
+class TextureArray {
+    GLuint id, placeholderId;
+    int width, height;
+    std::vector<int> handles;
+    std::vector<glm::vec2> scales;
+    bool complete;
+
+  public:
+    TextureArray() : id(0), placeholderId(0), width(0), height(0), complete(false) {}
+    ~TextureArray() {
+        if (id)
+            glDeleteTextures(1, &id);
+        if (placeholderId)
+            glDeleteTextures(1, &placeholderId);
+    }
+    TextureArray(const TextureArray &) = delete;
+    TextureArray &operator=(const TextureArray &) = delete;
+
+    // Reads only the image headers here; decoding and upload happen through
+    // the loader.
+    bool create(TextureLoader &loader, const std::vector<std::string> &paths, const std::string &cooked = "") {
+        if (!cooked.empty() && createCooked(paths, cooked))
+            return true;
+
+        std::vector<glm::vec2> sizes;
+        for (auto &path : paths) {
+            int w = 1, h = 1, nrChannels;
+            if (!stbi_info(path.c_str(), &w, &h, &nrChannels))
+                std::cout << "Failed to read texture header " << path << std::endl;
+            sizes.push_back(glm::vec2((float)w, (float)h));
+            width = std::max(width, w);
+            height = std::max(height, h);
+        }
+        if (paths.empty())
+            return false;
+
+        int layers = (int)paths.size();
+        int levels = Mipmap::levelCount(width, height);
+
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, width, height, layers);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // One grey texel per layer until the real data is in
+        std::vector<unsigned char> grey((size_t)layers * 4, 128);
+        glGenTextures(1, &placeholderId);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, placeholderId);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, 1, 1, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey.data());
+
+        for (int i = 0; i < layers; i++) {
+            handles.push_back(loader.loadLayer(paths[i], id, i, width, height));
+            scales.push_back(glm::vec2(sizes[i].x / width, sizes[i].y / height));
+        }
+        return true;
+    }
+
+    // Uploads the whole mip chain from a cooked file in one go. Fails (and
+    // leaves the array untouched) if the file is stale, does not match paths
+    // or uses a compressed format the driver cannot sample.
+    bool createCooked(const std::vector<std::string> &paths, const std::string &cooked) {
+        CookedTexture file;
+        if (!CookedTexture::upToDate(paths, cooked) || !file.open(cooked))
+            return false;
+        const CookedTexture::Header &info = file.info();
+        if (info.layers != paths.size() || !file.supported())
+            return false;
+
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        file.upload();
+
+        width = info.width;
+        height = info.height;
+        for (uint32_t i = 0; i < info.layers; i++)
+            scales.push_back(glm::vec2(file.scaleX(i), file.scaleY(i)));
+        placeholderId = 0;
+        complete = true;
+        return true;
+    }
+
+    // The array once every layer has been uploaded with its mip chain, the
+    // placeholder before that.
+    GLuint texture(const TextureLoader &loader) {
+        if (!complete) {
+            for (int handle : handles)
+                if (!loader.ready(handle) && !loader.failed(handle))
+                    return placeholderId;
+            complete = true;
+        }
+        return id;
+    }
+
+    int layers() const { return (int)handles.size(); }
+    const std::vector<glm::vec2> &layerScale() const { return scales; }
+};
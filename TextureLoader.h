@@ -0,0 +1,280 @@
+#pragma once
+#include <GL/glew.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mipmap.h"
+#include "stb_image.h"
+
+// Asynchronous texture loader. Images are decoded by stb_image on a pool of
+// worker threads; the GL thread then streams the decoded pixels into the
+// texture through a pixel buffer object, a few rows per frame, so no single
+// frame pays for a whole upload. The workers also build the mip chain (see
+// Mipmap.h), and every level is streamed the same way. Until a texture is
+// complete, texture() returns a small placeholder.
+//
+// Images can also be streamed into one layer of a GL_TEXTURE_2D_ARRAY
+// (see TextureArray.h); images smaller than the layer are padded by
+// repeating their last row and column.
+//
+// start(), update() and texture() must be called on the thread that owns the
+// GL context.
+class TextureLoader {
+    struct Entry {
+        std::string path;
+        GLuint id;
+        GLenum target;             // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+        int layer;                 // array layer, 0 for 2D textures
+        int padWidth, padHeight;   // array layer size, 0 for 2D textures
+        bool srgb;                 // mips averaged in linear light
+        bool ready;
+        bool failed;
+    };
+
+    struct Decoded {
+        int handle;
+        int width, height;
+        unsigned char *pixels;              // RGBA, owned by stb_image
+        std::vector<unsigned char> padded;  // used instead of pixels when padding
+        Mipmap mips;
+        int level, rowsUploaded; // upload position
+
+        const unsigned char *data() const { return padded.empty() ? pixels : padded.data(); }
+        const unsigned char *levelData() const { return level ? mips.data(level) : data(); }
+    };
+
+    std::vector<Entry> entries;
+    GLuint placeholderId;
+    GLuint pbo;
+    size_t pboSize;
+    size_t uploadBudget; // bytes copied into the PBO per update()
+    int mipThreads;      // per worker, so all workers together use every core
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<int> jobs;        // handles waiting to be decoded
+    std::deque<Decoded> decoded; // images waiting to be uploaded
+    int inFlight;                // handles not yet ready or failed
+    bool stopping;
+
+    void worker() {
+        for (;;) {
+            int handle, padWidth, padHeight;
+            bool srgb;
+            std::string path;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+                handle = jobs.front();
+                jobs.pop_front();
+                path = entries[handle].path;
+                padWidth = entries[handle].padWidth;
+                padHeight = entries[handle].padHeight;
+                srgb = entries[handle].srgb;
+            }
+
+            // Always decode to RGBA so every row is 4-byte aligned for the PBO
+            int width, height, nrChannels;
+            unsigned char *data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
+            Decoded image = {handle, width, height, data, {}, Mipmap(), 0, 0};
+            if (data && padWidth && (width != padWidth || height != padHeight))
+                pad(image, padWidth, padHeight);
+            if (image.data())
+                image.mips.build(image.data(), image.width, image.height, srgb, mipThreads);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(std::move(image));
+        }
+    }
+
+    // Grows (or crops) the image to w x h, repeating the last row and column
+    // so mipmaps of the layer do not bleed in a border colour.
+    static void pad(Decoded &image, int w, int h) {
+        image.padded.resize((size_t)w * h * 4);
+        for (int y = 0; y < h; y++) {
+            const unsigned char *src = image.pixels + (size_t)std::min(y, image.height - 1) * image.width * 4;
+            unsigned char *dst = &image.padded[(size_t)y * w * 4];
+            int copy = std::min(w, image.width);
+            memcpy(dst, src, (size_t)copy * 4);
+            for (int x = copy; x < w; x++)
+                memcpy(dst + x * 4, src + (copy - 1) * 4, 4);
+        }
+        stbi_image_free(image.pixels);
+        image.pixels = NULL;
+        image.width = w;
+        image.height = h;
+    }
+
+    // Copies as many rows of the current level as the budget allows into the
+    // PBO and uploads them. Returns true once every level is in the texture.
+    bool uploadRows(Decoded &image) {
+        const Mipmap::Level &level = image.mips.level(image.level);
+        size_t rowBytes = (size_t)level.width * 4;
+        int rows = (int)std::max<size_t>(1, uploadBudget / rowBytes);
+        rows = std::min(rows, level.height - image.rowsUploaded);
+        size_t bytes = rowBytes * rows;
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        if (bytes > pboSize) {
+            pboSize = bytes;
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, pboSize, NULL, GL_STREAM_DRAW);
+        }
+        void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (dst) {
+            memcpy(dst, image.levelData() + rowBytes * image.rowsUploaded, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            const Entry &entry = entries[image.handle];
+            glBindTexture(entry.target, entry.id);
+            if (entry.target == GL_TEXTURE_2D_ARRAY)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, image.level, 0, image.rowsUploaded, entry.layer, level.width,
+                                rows, 1, GL_RGBA, GL_UNSIGNED_BYTE, (void *)0);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, image.level, 0, image.rowsUploaded, level.width, rows, GL_RGBA,
+                                GL_UNSIGNED_BYTE, (void *)0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        image.rowsUploaded += rows;
+        if (image.rowsUploaded >= level.height) {
+            image.level++;
+            image.rowsUploaded = 0;
+        }
+        return image.level >= image.mips.count();
+    }
+
+  public:
+    TextureLoader(size_t uploadBudget = 4 << 20)
+        : placeholderId(0), pbo(0), pboSize(0), uploadBudget(uploadBudget), mipThreads(1), inFlight(0),
+          stopping(false) {}
+
+    ~TextureLoader() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : workers)
+            t.join();
+        for (auto &image : decoded)
+            stbi_image_free(image.pixels);
+    }
+
+    // Creates the placeholder texture and the staging PBO, and spawns the
+    // decoder threads.
+    void start(int threads = 0) {
+        if (threads <= 0)
+            threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+        mipThreads = std::max(1, (int)std::thread::hardware_concurrency() / threads);
+
+        // 2x2 grey checkerboard
+        const unsigned char checker[] = {
+            160, 160, 160, 255, 96,  96,  96,  255,
+            96,  96,  96,  255, 160, 160, 160, 255,
+        };
+        glGenTextures(1, &placeholderId);
+        glBindTexture(GL_TEXTURE_2D, placeholderId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, checker);
+
+        glGenBuffers(1, &pbo);
+
+        for (int i = 0; i < threads; i++)
+            workers.emplace_back(&TextureLoader::worker, this);
+    }
+
+    // Queues an image for decoding and returns its handle. srgb = false for
+    // data such as normal maps, whose mips must not be gamma corrected.
+    int load(const std::string &path, bool srgb = true) {
+        GLuint id;
+        glGenTextures(1, &id);
+        glBindTexture(GL_TEXTURE_2D, id);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        return enqueue({path, id, GL_TEXTURE_2D, 0, 0, 0, srgb, false, false});
+    }
+
+    // Queues an image for one layer (all of its mip levels) of an already
+    // allocated w x h texture array with a full mip chain.
+    int loadLayer(const std::string &path, GLuint array, int layer, int w, int h, bool srgb = true) {
+        return enqueue({path, array, GL_TEXTURE_2D_ARRAY, layer, w, h, srgb, false, false});
+    }
+
+    int enqueue(const Entry &entry) {
+        int handle;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handle = (int)entries.size();
+            entries.push_back(entry);
+            jobs.push_back(handle);
+            inFlight++;
+        }
+        wake.notify_one();
+        return handle;
+    }
+
+    // Advances pending uploads by at most one budget's worth of pixels.
+    // Call once per frame.
+    void update() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (decoded.empty())
+            return;
+        Decoded &image = decoded.front();
+        lock.unlock();
+
+        // The front element is only ever touched by this thread, and deque
+        // references stay valid while workers push_back.
+        Entry &entry = entries[image.handle];
+        bool done = false;
+        if (!image.data()) {
+            std::cout << "Failed to load texture " << entry.path << std::endl;
+            entry.failed = true;
+            done = true;
+        } else {
+            if (image.level == 0 && image.rowsUploaded == 0 && entry.target == GL_TEXTURE_2D) {
+                glBindTexture(GL_TEXTURE_2D, entry.id);
+                glTexStorage2D(GL_TEXTURE_2D, image.mips.count(), GL_RGBA8, image.width, image.height);
+            }
+            if (uploadRows(image)) {
+                stbi_image_free(image.pixels);
+                entry.ready = true;
+                done = true;
+            }
+        }
+
+        if (done) {
+            lock.lock();
+            decoded.pop_front();
+            inFlight--;
+        }
+    }
+
+    // The texture for a handle, or the placeholder while it is still loading.
+    GLuint texture(int handle) const {
+        const Entry &entry = entries[handle];
+        return entry.ready ? entry.id : placeholderId;
+    }
+
+    bool ready(int handle) const { return entries[handle].ready; }
+    bool failed(int handle) const { return entries[handle].failed; }
+
+    // True while any queued image has not been uploaded (or failed) yet.
+    bool pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return inFlight > 0;
+    }
+};
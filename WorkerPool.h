@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads that split large loops between them. parallelFor(count, fn) calls
+// fn(begin, end) on disjoint ranges of [0, count), on the workers and on the
+// calling thread, and returns once every range is done. Loops of up to
+// minChunk items are not worth waking the workers for and run on the
+// calling thread alone.
+class WorkerPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    const std::function<void(size_t, size_t)> *job;
+    size_t minChunk, jobCount, jobChunk, jobChunks;
+    std::atomic<size_t> nextChunk;
+    unsigned generation;
+    int active; // workers inside work(); the job is only replaced while 0
+    bool stopping;
+
+    // Claims chunks of the current job until none are left.
+    void work() {
+        for (size_t c = nextChunk++; c < jobChunks; c = nextChunk++) {
+            size_t begin = c * jobChunk;
+            (*job)(begin, std::min(jobCount, begin + jobChunk));
+        }
+    }
+
+    void worker(unsigned seen) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                active++;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0)
+                done.notify_all();
+        }
+    }
+
+  public:
+    WorkerPool(size_t minChunk)
+        : job(NULL), minChunk(minChunk), jobCount(0), jobChunk(1), jobChunks(0), nextChunk(0), generation(0),
+          active(0), stopping(false) {}
+    ~WorkerPool() { stop(); }
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    // Starts threads - 1 workers (the calling thread takes part in every
+    // loop as well); threads <= 0 uses one per core.
+    void start(int threads = 0) {
+        if (threads <= 0)
+            threads = std::max(1, (int)std::thread::hardware_concurrency());
+        for (int i = 1; i < threads; i++)
+            workers.emplace_back(&WorkerPool::worker, this, generation);
+    }
+
+    // Joins the workers; call it only while no parallelFor() is running.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &t : workers)
+            t.join();
+        workers.clear();
+        stopping = false;
+    }
+
+    int threads() const { return (int)workers.size() + 1; }
+
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)> &fn) {
+        if (workers.empty() || count <= minChunk) {
+            fn(0, count);
+            return;
+        }
+        size_t threads = workers.size() + 1;
+        {
+            // Workers woken late for the previous job may still be looking
+            // at it
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this] { return active == 0; });
+            job = &fn;
+            jobCount = count;
+            // A few chunks per thread, so uneven ranges still balance
+            jobChunk = std::max(minChunk / 4, (count + threads * 4 - 1) / (threads * 4));
+            jobChunks = (count + jobChunk - 1) / jobChunk;
+            nextChunk = 0;
+            generation++;
+        }
+        wake.notify_all();
+        work();
+        // Every chunk is claimed now; wait for the ones still running
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return active == 0; });
+    }
+};
@@ -0,0 +1,29 @@
+#version 400
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+uniform vec2 direction; // (1,0) horizontal pass, (0,1) vertical pass
+uniform vec2 uvMax;     // last texel centre the frame covers
+
+// 9-tap Gaussian folded into 5 bilinear fetches
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
+
+vec3 fetch(vec2 uv)
+{
+    return texture(source, min(uv, uvMax)).rgb;
+}
+
+void main()
+{
+    vec2 step = direction * texelSize;
+    vec3 color = fetch(TexCoord) * weights[0];
+    for (int i = 1; i < 3; i++) {
+        color += fetch(TexCoord + step * offsets[i]) * weights[i];
+        color += fetch(TexCoord - step * offsets[i]) * weights[i];
+    }
+    FragColor = vec4(color, 1.0);
+}
\ No newline at end of file
@@ -1011,6 +1011,17 @@ else(FLTK_USE_XRENDER)
   set(FLTK_XRENDER_FOUND FALSE)
 endif(FLTK_USE_XRENDER)
 
+#######################################################################
+if(X11_XShm_FOUND AND X11_Xext_FOUND)
+  option(FLTK_USE_XSHM "use the MIT-SHM extension to draw images" ON)
+endif(X11_XShm_FOUND AND X11_Xext_FOUND)
+
+if(FLTK_USE_XSHM AND X11_XShm_FOUND AND X11_Xext_FOUND)
+  set(HAVE_XSHM 1)
+else()
+  set(HAVE_XSHM 0)
+endif()
+
 #######################################################################
 set(FL_NO_PRINT_SUPPORT FALSE)
 if(X11_FOUND AND NOT FLTK_OPTION_PRINT_SUPPORT)
@@ -375,6 +375,27 @@ void Fl_Graphics_Driver::line(int x, int y, int x1, int y1, int x2, int y2) {
   line(x1, y1, x2, y2);
 }
 
+// Four segments that close a quadrilateral go out as one loop(), which the
+// platforms without a batched segments() draw with a single call.
+void Fl_Graphics_Driver::segments(int n, const int *xy) {
+  for (int i = 0; i < n;) {
+    const int *q = xy;
+    if (i + 4 <= n && q[2] == q[4] && q[3] == q[5] && q[6] == q[8] && q[7] == q[9] &&
+        q[10] == q[12] && q[11] == q[13] && q[14] == q[0] && q[15] == q[1]) {
+      loop(q[0], q[1], q[4], q[5], q[8], q[9], q[12], q[13]);
+      i += 4; xy += 16;
+    } else {
+      line(xy[0], xy[1], xy[2], xy[3]);
+      i++; xy += 4;
+    }
+  }
+}
+
+void Fl_Graphics_Driver::polyline(int n, const int *xy) {
+  for (int i = 1; i < n; i++, xy += 2)
+    line(xy[0], xy[1], xy[2], xy[3]);
+}
+
 void Fl_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2) {
   line(x0, y0, x1, y1);
   line(x1, y1, x2, y2);
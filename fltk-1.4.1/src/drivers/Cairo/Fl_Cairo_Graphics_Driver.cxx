@@ -190,6 +190,32 @@ void Fl_Cairo_Graphics_Driver::line(int x0, int y0, int x1, int y1, int x2, int
   surface_needs_commit();
 }
 
+// all segments in one path, stroked once
+void Fl_Cairo_Graphics_Driver::segments(int n, const int *xy) {
+  if (n <= 0) return;
+  cairo_new_path(cairo_);
+  for (int i = 0; i < n; i++, xy += 4) {
+    cairo_move_to(cairo_, xy[0], xy[1]);
+    cairo_line_to(cairo_, xy[2], xy[3]);
+  }
+  bool needit = need_antialias_none(cairo_, linestyle_);
+  cairo_stroke(cairo_);
+  if (needit) cairo_set_antialias(cairo_, CAIRO_ANTIALIAS_DEFAULT);
+  surface_needs_commit();
+}
+
+void Fl_Cairo_Graphics_Driver::polyline(int n, const int *xy) {
+  if (n < 2) return;
+  cairo_new_path(cairo_);
+  cairo_move_to(cairo_, xy[0], xy[1]);
+  for (int i = 1; i < n; i++)
+    cairo_line_to(cairo_, xy[2*i], xy[2*i+1]);
+  bool needit = need_antialias_none(cairo_, linestyle_);
+  cairo_stroke(cairo_);
+  if (needit) cairo_set_antialias(cairo_, CAIRO_ANTIALIAS_DEFAULT);
+  surface_needs_commit();
+}
+
 void Fl_Cairo_Graphics_Driver::xyline(int x, int y, int x1) {
   cairo_move_to(cairo_, x, y);
   cairo_line_to(cairo_, x1, y);
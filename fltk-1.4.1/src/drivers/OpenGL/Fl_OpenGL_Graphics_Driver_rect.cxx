@@ -95,6 +95,38 @@ void Fl_OpenGL_Graphics_Driver::line(int x, int y, int x1, int y1, int x2, int y
   line(x1, y1, x2, y2);
 }
 
+// One glDrawArrays() straight from the caller's array (OpenGL 1.1 client
+// side vertex array, no copy); offset by half a pixel like line(). Wide
+// lines need a quad per segment, as in line().
+static void draw_int_array(GLenum mode, int count, const int *xy) {
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(2, GL_INT, 0, xy);
+  glPushMatrix();
+  glTranslatef(0.5f, 0.5f, 0.0f);
+  glDrawArrays(mode, 0, count);
+  glPopMatrix();
+  glPopClientAttrib();
+}
+
+void Fl_OpenGL_Graphics_Driver::segments(int n, const int *xy) {
+  if (n <= 0) return;
+  if (line_width_ != 1.0f) {
+    Fl_Graphics_Driver::segments(n, xy);
+    return;
+  }
+  draw_int_array(GL_LINES, 2 * n, xy);
+}
+
+void Fl_OpenGL_Graphics_Driver::polyline(int n, const int *xy) {
+  if (n < 2) return;
+  if (line_width_ != 1.0f) {
+    Fl_Graphics_Driver::polyline(n, xy);
+    return;
+  }
+  draw_int_array(GL_LINE_STRIP, n, xy);
+}
+
 void Fl_OpenGL_Graphics_Driver::xyline(int x, int y, int x1) {
   float offset = line_width_ / 2.0f;
   float xx = (float)x, yy = y+0.5f, rr = x1+1.0f;
@@ -43,6 +43,8 @@ GC fl_x11_gc() { return fl_gc; }
 Fl_Xlib_Graphics_Driver::Fl_Xlib_Graphics_Driver(void) {
   mask_bitmap_ = NULL;
   short_point = NULL;
+  batch_buffer_ = NULL;
+  batch_buffer_size_ = 0;
 #if USE_PANGO
   Fl_Graphics_Driver::font(0, 0);
 #endif
@@ -53,6 +55,7 @@ Fl_Xlib_Graphics_Driver::Fl_Xlib_Graphics_Driver(void) {
 
 Fl_Xlib_Graphics_Driver::~Fl_Xlib_Graphics_Driver() {
   if (short_point) free(short_point);
+  if (batch_buffer_) free(batch_buffer_);
 }
 
 
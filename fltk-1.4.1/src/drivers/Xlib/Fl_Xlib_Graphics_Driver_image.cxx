@@ -61,6 +61,11 @@
 #    define RepeatPad  2
 #  endif
 #endif // HAVE_XRENDER
+#if HAVE_XSHM
+#  include <sys/ipc.h>
+#  include <sys/shm.h>
+#  include <X11/extensions/XShm.h>
+#endif // HAVE_XSHM
 
 static XImage xi;       // template used to pass info to X
 static int bytes_per_pixel;
@@ -310,19 +315,174 @@ static void rrr_converter(const uchar *from, uchar *to, int w, int delta) {
   U32 *t = (U32*)to; for (; w--; from += delta) *t++ = f
 #  endif
 
+////////////////////////////////////////////////////////////////
+// Vectorized 32bit converters:
+// Most of the 32bit converters only move bytes around (and perhaps
+// premultiply by alpha), which is described by a pixel32 layout. When the
+// CPU has byte shuffles (SSSE3, AVX2 or NEON, picked at run time) the
+// bulk of a row is converted by simd32, which returns how many pixels it
+// did, and the converter does the rest.
+
+struct pixel32 {
+  signed char value[4]; // byte of the input pixel put into bits 0-7, 8-15,
+                        // 16-23 and 24-31 of the output, -1 for 0
+  signed char alpha;    // index into value[] of the alpha the others are
+                        // premultiplied with, -1 for none
+};
+
+static int (*simd32)(const uchar *from, uchar *to, int w, int delta, const pixel32 &p);
+
+#  define SIMD32(b0, b1, b2, b3, a) \
+  if (simd32) { \
+    static const pixel32 p = {{b0, b1, b2, b3}, a}; \
+    int n = simd32(from, to, w, delta, p); \
+    from += n*delta; to += n*4; w -= n; \
+  }
+
+// Builds the byte shuffle control for 4 pixels, and for premultiplying the
+// one fetching each byte's alpha (255 for the alpha itself). Returns false
+// if the layout reads past delta.
+static bool pixel32_controls(const pixel32 &p, int delta, uchar *control, uchar *alpha) {
+  if (delta < 1 || delta > 4) return false;
+  for (int v = 0; v < 4; v++)
+    if (p.value[v] >= delta) return false;
+  for (int k = 0; k < 4; k++)
+    for (int v = 0; v < 4; v++) {
+      int m = 4*k + (WORDS_BIGENDIAN ? 3-v : v);    // where byte v is in memory
+      control[m] = p.value[v] < 0 ? 0x80 : uchar(k*delta + p.value[v]);
+      alpha[m] = p.alpha < 0 || v == p.alpha ? 0x80 : uchar(k*delta + p.value[p.alpha]);
+    }
+  return true;
+}
+
+#  if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#    include <immintrin.h>
+
+// c*a/255 (rounded down) of 16-bit products
+#    define DIV255_128(v) \
+  _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(v, _mm_set1_epi16(1)), _mm_srli_epi16(v, 8)), 8)
+#    define DIV255_256(v) \
+  _mm256_srli_epi16(_mm256_add_epi16(_mm256_add_epi16(v, _mm256_set1_epi16(1)), _mm256_srli_epi16(v, 8)), 8)
+
+// 4 pixels at a time, 16 bytes are read. Alpha bytes are multiplied by
+// 255: 0 is shuffled in there and or'ed with a255.
+#    define CONVERT32_128 \
+  for (; (w-i)*delta >= 16; i += 4) { \
+    __m128i in = _mm_loadu_si128((const __m128i *)(from + i*delta)); \
+    __m128i out = _mm_shuffle_epi8(in, c); \
+    if (p.alpha >= 0) { \
+      __m128i m = _mm_or_si128(_mm_shuffle_epi8(in, a), a255), z = _mm_setzero_si128(); \
+      __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(out, z), _mm_unpacklo_epi8(m, z)); \
+      __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(out, z), _mm_unpackhi_epi8(m, z)); \
+      out = _mm_packus_epi16(DIV255_128(lo), DIV255_128(hi)); \
+    } \
+    _mm_storeu_si128((__m128i *)(to + i*4), out); \
+  }
+
+__attribute__((target("ssse3")))
+static int ssse3_convert32(const uchar *from, uchar *to, int w, int delta, const pixel32 &p) {
+  uchar control[16], alpha[16];
+  if (!pixel32_controls(p, delta, control, alpha)) return 0;
+  __m128i c = _mm_loadu_si128((const __m128i *)control);
+  __m128i a = _mm_loadu_si128((const __m128i *)alpha);
+  __m128i a255 = _mm_cmpeq_epi8(a, _mm_set1_epi8(char(0x80)));
+  int i = 0;
+  CONVERT32_128
+  return i;
+}
+
+__attribute__((target("avx2")))
+static int avx2_convert32(const uchar *from, uchar *to, int w, int delta, const pixel32 &p) {
+  uchar control[16], alpha[16];
+  if (!pixel32_controls(p, delta, control, alpha)) return 0;
+  __m128i c = _mm_loadu_si128((const __m128i *)control);
+  __m128i a = _mm_loadu_si128((const __m128i *)alpha);
+  __m128i a255 = _mm_cmpeq_epi8(a, _mm_set1_epi8(char(0x80)));
+  // the same controls in both lanes, each lane converting 4 pixels
+  __m256i c2 = _mm256_broadcastsi128_si256(c);
+  __m256i a2 = _mm256_broadcastsi128_si256(a);
+  __m256i a255_2 = _mm256_broadcastsi128_si256(a255);
+  __m256i z = _mm256_setzero_si256();
+  int i = 0;
+  for (; (w-i)*delta >= 4*delta+16; i += 8) {
+    const uchar *f = from + i*delta;
+    __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)f)),
+                                         _mm_loadu_si128((const __m128i *)(f + 4*delta)), 1);
+    __m256i out = _mm256_shuffle_epi8(in, c2);
+    if (p.alpha >= 0) {
+      __m256i m = _mm256_or_si256(_mm256_shuffle_epi8(in, a2), a255_2);
+      __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(out, z), _mm256_unpacklo_epi8(m, z));
+      __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(out, z), _mm256_unpackhi_epi8(m, z));
+      out = _mm256_packus_epi16(DIV255_256(lo), DIV255_256(hi));
+    }
+    _mm256_storeu_si256((__m256i *)(to + i*4), out);
+  }
+  // the rest stays in AVX code, mixing in SSE code would be slow
+  CONVERT32_128
+  return i;
+}
+
+static void init_simd32() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) simd32 = avx2_convert32;
+  else if (__builtin_cpu_supports("ssse3")) simd32 = ssse3_convert32;
+}
+
+#  elif defined(__aarch64__) && defined(__ARM_NEON)
+#    include <arm_neon.h>
+
+static uint8x16_t div255_neon(uint16x8_t lo, uint16x8_t hi) {
+  lo = vshrq_n_u16(vaddq_u16(vaddq_u16(lo, vdupq_n_u16(1)), vshrq_n_u16(lo, 8)), 8);
+  hi = vshrq_n_u16(vaddq_u16(vaddq_u16(hi, vdupq_n_u16(1)), vshrq_n_u16(hi, 8)), 8);
+  return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+static int neon_convert32(const uchar *from, uchar *to, int w, int delta, const pixel32 &p) {
+  uchar control[16], alpha[16];
+  if (!pixel32_controls(p, delta, control, alpha)) return 0;
+  // table lookups give 0 for indexes out of range, like 0x80
+  uint8x16_t c = vld1q_u8(control);
+  uint8x16_t a = vld1q_u8(alpha);
+  uint8x16_t a255 = vceqq_u8(a, vdupq_n_u8(0x80));
+  int i = 0;
+  for (; (w-i)*delta >= 16; i += 4) {
+    uint8x16_t in = vld1q_u8(from + i*delta);
+    uint8x16_t out = vqtbl1q_u8(in, c);
+    if (p.alpha >= 0) {
+      uint8x16_t m = vorrq_u8(vqtbl1q_u8(in, a), a255);
+      out = div255_neon(vmull_u8(vget_low_u8(out), vget_low_u8(m)),
+                        vmull_u8(vget_high_u8(out), vget_high_u8(m)));
+    }
+    vst1q_u8(to + i*4, out);
+  }
+  return i;
+}
+
+static void init_simd32() { simd32 = neon_convert32; }
+
+#  else
+
+static void init_simd32() {}
+
+#  endif
+
 static void rgbx_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(-1, 2, 1, 0, -1);
   INNARDS32((unsigned(from[0])<<24)+(from[1]<<16)+(from[2]<<8));
 }
 
 static void xbgr_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(0, 1, 2, -1, -1);
   INNARDS32((from[0])+(from[1]<<8)+(from[2]<<16));
 }
 
 static void xrgb_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(2, 1, 0, -1, -1);
   INNARDS32((from[0]<<16)+(from[1]<<8)+(from[2]));
 }
 
 static void argb_premul_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(2, 1, 0, 3, 3);
   INNARDS32((unsigned(from[3]) << 24) +
              (((from[0] * from[3]) / 255) << 16) +
              (((from[1] * from[3]) / 255) << 8) +
@@ -330,6 +490,7 @@ static void argb_premul_converter(const uchar *from, uchar *to, int w, int delta
 }
 
 static void depth2_to_argb_premul_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(0, 0, 0, 1, 3);
   INNARDS32((unsigned(from[1]) << 24) +
             (((from[0] * from[1]) / 255) << 16) +
             (((from[0] * from[1]) / 255) << 8) +
@@ -337,14 +498,17 @@ static void depth2_to_argb_premul_converter(const uchar *from, uchar *to, int w,
 }
 
 static void bgrx_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(-1, 0, 1, 2, -1);
   INNARDS32((from[0]<<8)+(from[1]<<16)+(unsigned(from[2])<<24));
 }
 
 static void rrrx_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(-1, 0, 0, 0, -1);
   INNARDS32(unsigned(*from) * 0x1010100U);
 }
 
 static void xrrr_converter(const uchar *from, uchar *to, int w, int delta) {
+  SIMD32(0, 0, 0, -1, -1);
   INNARDS32(*from * 0x10101U);
 }
 
@@ -391,6 +555,8 @@ static void figure_out_visual() {
   scanline_add = n-1;
   scanline_mask = -n;
 
+  init_simd32();
+
 #  if USE_COLORMAP
   if (bytes_per_pixel == 1) {
     converter = color8_converter;
@@ -469,6 +635,123 @@ static void figure_out_visual() {
 
 #  define MAXBUFFER 0x40000 // 256k
 
+#if HAVE_XSHM
+
+// MIT-SHM: images are converted straight into a memory segment shared
+// with the X server, which then reads them from there instead of having
+// every pixel copied over the connection. One segment is kept and grown
+// as needed. Small images are not worth the round trip this costs.
+
+#  define SHM_MIN_SIZE 0x10000 // 64k bytes
+#  define SHM_GRANULE 0x100000 // segment sizes are multiples of 1M
+
+static XShmSegmentInfo shm_info;
+static size_t shm_size;         // 0 = no segment attached
+static int shm_state;           // 0 = not checked yet, 1 = usable, -1 = not
+static bool shm_busy;           // the server may still be reading the segment
+static bool shm_attach_failed;
+
+static int shm_error_handler(Display *, XErrorEvent *) {
+  shm_attach_failed = true;
+  return 0;
+}
+
+static void shm_release() {
+  XShmDetach(fl_display, &shm_info);
+  XSync(fl_display, False);
+  shmdt(shm_info.shmaddr);
+  shm_info.shmaddr = 0;
+  shm_size = 0;
+  shm_busy = false;
+}
+
+// Returns the shared segment, grown to at least size bytes and free to be
+// written, or NULL if MIT-SHM can't be used. The extension may be present
+// yet unusable when the server runs on another machine; the first attach
+// fails then and the extension isn't tried again.
+static char *shm_buffer(size_t size) {
+  if (!shm_state) shm_state = XShmQueryExtension(fl_display) ? 1 : -1;
+  if (shm_state < 0) return 0;
+  if (size <= shm_size) {
+    if (shm_busy) {             // wait for the last XShmPutImage to be done
+      XSync(fl_display, False);
+      shm_busy = false;
+    }
+    return shm_info.shmaddr;
+  }
+  if (shm_size) shm_release();
+  size = (size + SHM_GRANULE - 1) & ~(size_t)(SHM_GRANULE - 1);
+  int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (id < 0) return 0;         // out of segments: use XPutImage this time
+  char *addr = (char *)shmat(id, 0, 0);
+  if (addr == (char *)-1) {
+    shmctl(id, IPC_RMID, 0);
+    return 0;
+  }
+  shm_info.shmid = id;
+  shm_info.shmaddr = addr;
+  shm_info.readOnly = True;
+  XSync(fl_display, False);
+  shm_attach_failed = false;
+  XErrorHandler old_handler = XSetErrorHandler(shm_error_handler);
+  XShmAttach(fl_display, &shm_info);
+  XSync(fl_display, False);
+  XSetErrorHandler(old_handler);
+  // the segment goes away once both sides have detached (or exited)
+  shmctl(id, IPC_RMID, 0);
+  if (shm_attach_failed) {
+    shmdt(addr);
+    shm_info.shmaddr = 0;
+    shm_state = -1;
+    return 0;
+  }
+  shm_size = size;
+  return addr;
+}
+
+// Converts the visible part of the image (w*h pixels at dx,dy) into the
+// shared segment and draws it with a single request. Returns false if
+// MIT-SHM can't be used for it; nothing has been drawn then.
+static bool shm_innards(const uchar *buf, int X, int Y, int W, int delta, int linedelta,
+                        Fl_Draw_Image_Cb cb, void *userdata,
+                        void (*conv)(const uchar *from, uchar *to, int w, int delta),
+                        GC gc, int dx, int dy, int w, int h)
+{
+  int linesize = ((w*bytes_per_pixel+scanline_add)&scanline_mask)/sizeof(STORETYPE);
+  int bytes_per_line = linesize*sizeof(STORETYPE);
+  // The server computes the line length from the image width, so that must
+  // include the padding, which isn't possible with 3 bytes per pixel.
+  if (bytes_per_line % bytes_per_pixel) return false;
+  size_t size = (size_t)bytes_per_line*h;
+  if (size < SHM_MIN_SIZE) return false;
+  STORETYPE *data = (STORETYPE *)shm_buffer(size);
+  if (!data) return false;
+
+  if (buf) {
+    buf += delta*dx+linedelta*dy;
+    for (int j=0; j<h; j++, buf += linedelta)
+      conv(buf, (uchar*)(data + j*linesize), w, delta);
+  } else {
+    STORETYPE* linebuf = new STORETYPE[(W*delta+(sizeof(STORETYPE)-1))/sizeof(STORETYPE)];
+    for (int j=0; j<h; j++) {
+      cb(userdata, dx, dy+j, w, (uchar*)linebuf);
+      conv((uchar*)linebuf, (uchar*)(data + j*linesize), w, delta);
+    }
+    delete[] linebuf;
+  }
+
+  xi.data = (char *)data;
+  xi.bytes_per_line = bytes_per_line;
+  xi.width = bytes_per_line/bytes_per_pixel;
+  xi.obdata = (char *)&shm_info;
+  XShmPutImage(fl_display, fl_window, gc, &xi, 0, 0, X+dx, Y+dy, w, h, False);
+  xi.obdata = 0;
+  shm_busy = true;
+  return true;
+}
+
+#endif // HAVE_XSHM
+
 static void innards(const uchar *buf, int X, int Y, int W, int H,
                     int delta, int linedelta, int mono,
                     Fl_Draw_Image_Cb cb, void* userdata,
@@ -504,27 +787,30 @@ static void innards(const uchar *buf, int X, int Y, int W, int H,
     }
   }
 
-  // See if the data is already in the right format.  Unfortunately
-  // some 32-bit x servers (XFree86) care about the unknown 8 bits
-  // and they must be zero.  I can't confirm this for user-supplied
-  // data, so the 32-bit shortcut is disabled...
+  // See if the data is already in the right format.  Some 32-bit x
+  // servers (XFree86) care about the unknown 8 bits and they must be
+  // zero, so the 32-bit shortcut is only taken when they are padding
+  // (visuals of depth 24 or less), not for ARGB visuals or alpha images.
   // This can set bytes_per_line negative if image is bottom-to-top
   // I tested it on Linux, but it may fail on other Xlib implementations:
   if (buf && (
-#  if 0 // set this to 1 to allow 32-bit shortcut
-      delta == 4 &&
-#    if WORDS_BIGENDIAN
+      (delta == 4 && !alpha && fl_visual->depth <= 24 &&
+#  if WORDS_BIGENDIAN
       conv == rgbx_converter
-#    else
+#  else
       conv == xbgr_converter
-#    endif
-      ||
 #  endif
-      conv == rgb_converter && delta==3
+      ) ||
+      (conv == rgb_converter && delta==3)
       ) && !(linedelta&scanline_add)) {
     xi.data = (char *)(buf+delta*dx+linedelta*dy);
     xi.bytes_per_line = linedelta;
+    XPutImage(fl_display,fl_window,gc, &xi, 0, 0, X+dx, Y+dy, w, h);
 
+#if HAVE_XSHM
+  } else if (shm_innards(buf, X, Y, W, delta, linedelta, cb, userdata, conv, gc, dx, dy, w, h)) {
+    // drawn through the shared segment
+#endif // HAVE_XSHM
   } else {
     int linesize = ((w*bytes_per_pixel+scanline_add)&scanline_mask)/sizeof(STORETYPE);
     int blocking = h;
@@ -640,6 +926,86 @@ void Fl_Xlib_Graphics_Driver::draw_fixed(Fl_Bitmap *bm, int X, int Y, int W, int
   XSetFillStyle(fl_display, gc_, FillSolid);
 }
 
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+
+// blend_row() for 2 pixels widened to 16 bits per byte
+static inline __m128i blend_2(__m128i s, __m128i d) {
+  __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xff), 0xff);
+  a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+  __m128i ia = _mm_sub_epi16(_mm_set1_epi16(256), a);
+  return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)), 8);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#  include <arm_neon.h>
+
+// blend_row() for one channel of 8 pixels, alpha already scaled to 0..256
+static inline uint8x8_t blend_8(uint8x8_t s, uint8x8_t d, uint16x8_t a, uint16x8_t ia) {
+  return vshrn_n_u16(vaddq_u16(vmulq_u16(vmovl_u8(s), a), vmulq_u16(vmovl_u8(d), ia)), 8);
+}
+#endif
+
+// Composites w RGBA (d == 4) or grayscale + alpha (d == 2) pixels over
+// w RGBX ones in place. Alpha is scaled to 0..256 to compensate integer
+// rounding error, so 0 leaves dst and 255 copies src exactly. The X byte
+// of dst ends up undefined.
+static void blend_row(const uchar *src, uchar *dst, int w, int d) {
+  int x = 0;
+#if defined(__SSE2__)
+  __m128i z = _mm_setzero_si128();
+  for (; x + 4 <= w; x += 4, src += 4*d, dst += 16) {
+    __m128i s;
+    if (d == 4) {
+      s = _mm_loadu_si128((const __m128i *)src);
+    } else {                    // ga ga ga ga -> ggga ggga ggga ggga
+      __m128i ga = _mm_loadl_epi64((const __m128i *)src);
+      s = _mm_unpacklo_epi16(ga, ga);
+      s = _mm_or_si128(_mm_and_si128(s, _mm_set1_epi32(int(0xffff00ff))),
+                       _mm_slli_epi32(_mm_and_si128(s, _mm_set1_epi32(0xff)), 8));
+    }
+    __m128i t = _mm_loadu_si128((const __m128i *)dst);
+    __m128i lo = blend_2(_mm_unpacklo_epi8(s, z), _mm_unpacklo_epi8(t, z));
+    __m128i hi = blend_2(_mm_unpackhi_epi8(s, z), _mm_unpackhi_epi8(t, z));
+    _mm_storeu_si128((__m128i *)dst, _mm_packus_epi16(lo, hi));
+  }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+  for (; x + 8 <= w; x += 8, src += 8*d, dst += 32) {
+    uint8x8x4_t t = vld4_u8(dst);
+    uint8x8_t r, g, b, a8;
+    if (d == 4) {
+      uint8x8x4_t s = vld4_u8(src);
+      r = s.val[0]; g = s.val[1]; b = s.val[2]; a8 = s.val[3];
+    } else {
+      uint8x8x2_t s = vld2_u8(src);
+      r = g = b = s.val[0]; a8 = s.val[1];
+    }
+    uint16x8_t a = vmovl_u8(a8);
+    a = vaddq_u16(a, vshrq_n_u16(a, 7));
+    uint16x8_t ia = vsubq_u16(vdupq_n_u16(256), a);
+    t.val[0] = blend_8(r, t.val[0], a, ia);
+    t.val[1] = blend_8(g, t.val[1], a, ia);
+    t.val[2] = blend_8(b, t.val[2], a, ia);
+    vst4_u8(dst, t);
+  }
+#endif
+  for (; x < w; x++, src += d, dst += 4) {
+    unsigned a = src[d-1];
+    if (a == 0) continue;       // special case "ignore"
+    uchar r = src[0], g = src[d == 4 ? 1 : 0], b = src[d == 4 ? 2 : 0];
+    if (a == 255) {             // special case "copy"
+      dst[0] = r;
+      dst[1] = g;
+      dst[2] = b;
+    } else {                    // common case "blend"
+      a += a >> 7;
+      unsigned ia = 256 - a;
+      dst[0] = (r * a + dst[0] * ia) >> 8;
+      dst[1] = (g * a + dst[1] * ia) >> 8;
+      dst[2] = (b * a + dst[2] * ia) >> 8;
+    }
+  }
+}
+
 // Composite an image with alpha on systems that don't have accelerated
 // alpha compositing...
 static void alpha_blend(Fl_RGB_Image *img, int X, int Y, int W, int H, int cx, int cy) {
@@ -662,69 +1028,15 @@ static void alpha_blend(Fl_RGB_Image *img, int X, int Y, int W, int H, int cx, i
   if (ld == 0) ld = img->data_w() * img->d();
   uchar *srcptr = (uchar*)img->array + cy * ld + cx * img->d();
 
-  uchar *dst = fl_read_image(NULL, X, Y, W, H, 0);
+  // read back with 4 bytes per pixel, which keeps the blending aligned
+  uchar *dst = fl_read_image(NULL, X, Y, W, H, 255);
   if (!dst) {
     fl_draw_image(srcptr, X, Y, W, H, img->d(), ld);
     return;
   }
-  int srcskip = ld - img->d() * W;
-  uchar *dstptr = dst;
-
-  uchar srcr, srcg, srcb;  // source color components
-  uchar dstr, dstg, dstb;  // destination color components
-  unsigned int srca, dsta; // source alpha and inverse source alpha
-
-  if (img->d() == 2) {
-    // Composite grayscale + alpha over RGB...
-    for (int y = H; y > 0; y--, srcptr+=srcskip)
-      for (int x = W; x > 0; x--) {
-        srcg = *srcptr++;
-        srca = *srcptr++;
-        if (srca == 255) { // special case "copy"
-          *dstptr++ = srcg;
-          *dstptr++ = srcg;
-          *dstptr++ = srcg;
-        } else if (srca == 0) { // special case "ignore"
-          dstptr += 3;
-        } else { // common case "blend"
-          srca += srca>>7; // multiply by 1.004 to compensate integer rounding error
-          dstr = dstptr[0];
-          dstg = dstptr[1];
-          dstb = dstptr[2];
-          dsta = 256 - srca;
-          unsigned int srcg_pm = srcg * srca; // premultiply once
-          *dstptr++ = (srcg_pm + dstr * dsta) >> 8;
-          *dstptr++ = (srcg_pm + dstg * dsta) >> 8;
-          *dstptr++ = (srcg_pm + dstb * dsta) >> 8;
-        }
-      }
-  } else {
-    // Composite RGBA over RGB...
-    for (int y = H; y > 0; y--, srcptr+=srcskip)
-      for (int x = W; x > 0; x--) {
-        srcr = *srcptr++;
-        srcg = *srcptr++;
-        srcb = *srcptr++;
-        srca = *srcptr++;
-        if (srca == 255) { // special case "copy"
-          *dstptr++ = srcr;
-          *dstptr++ = srcg;
-          *dstptr++ = srcb;
-        } else if (srca == 0) { // special case "ignore"
-          dstptr += 3;
-        } else { // common case "blend"
-          srca += srca>>7; // multiply by 1.004 to compensate integer rounding error
-          dstr = dstptr[0];
-          dstg = dstptr[1];
-          dstb = dstptr[2];
-          dsta = 256 - srca;
-          *dstptr++ = (srcr * srca + dstr * dsta) >> 8;
-          *dstptr++ = (srcg * srca + dstg * dsta) >> 8;
-          *dstptr++ = (srcb * srca + dstb * dsta) >> 8;
-        }
-      }
-  }
-  fl_draw_image(dst, X, Y, W, H, 3, 0);
+  for (int y = 0; y < H; y++, srcptr += ld)
+    blend_row(srcptr, dst + 4*W*y, W, img->d());
+  fl_draw_image(dst, X, Y, W, H, 4, 0);
 
   delete[] dst;
 }
@@ -750,6 +1062,21 @@ void Fl_Xlib_Graphics_Driver::cache(Fl_RGB_Image *img) {
   cache_w_h(img, pw, ph);
   *pw = img->data_w();
   *ph = img->data_h();
+#if HAVE_XRENDER
+  if (depth & FL_IMAGE_WITH_ALPHA) {
+    // Images with alpha are kept as an ARGB32 Picture, composited by the
+    // server in draw_rgb(). The Picture keeps the pixmap alive.
+    static XRenderPictFormat *fmt32 = XRenderFindStandardFormat(fl_display, PictStandardARGB32);
+    XRenderPictureAttributes srcattr;
+    memset(&srcattr, 0, sizeof(XRenderPictureAttributes));
+    srcattr.repeat = RepeatPad;
+    Picture picture = XRenderCreatePicture(fl_display, (Pixmap)off, fmt32, CPRepeat, &srcattr);
+    XFreePixmap(fl_display, (Pixmap)off);
+    *Fl_Graphics_Driver::id(img) = (fl_uintptr_t)picture;
+    *Fl_Graphics_Driver::mask(img) = 0;
+    return;
+  }
+#endif
   *Fl_Graphics_Driver::id(img) = (fl_uintptr_t)off;
 }
 
@@ -798,10 +1125,16 @@ void Fl_Xlib_Graphics_Driver::draw_rgb(Fl_RGB_Image *rgb, int XP, int YP, int WP
   if (Wfull == 0 || Hfull == 0) return;
   bool need_clip = (cx || cy || WP < rgb->w() || HP < rgb->h());
   if (need_clip) push_clip(XP, YP, WP, HP);
-  scale_and_render_pixmap( *Fl_Graphics_Driver::id(rgb), rgb->d(),
-                          rgb->data_w() / double(Wfull), rgb->data_h() / double(Hfull),
-                          Xs + this->floor(offset_x_), Ys + this->floor(offset_y_),
-                          Wfull, Hfull);
+  if (rgb->d() == 2 || rgb->d() == 4)
+    render_picture(*Fl_Graphics_Driver::id(rgb), true,
+                   rgb->data_w() / double(Wfull), rgb->data_h() / double(Hfull),
+                   Xs + this->floor(offset_x_), Ys + this->floor(offset_y_),
+                   Wfull, Hfull, *Fl_Graphics_Driver::mask(rgb));
+  else
+    scale_and_render_pixmap( *Fl_Graphics_Driver::id(rgb), rgb->d(),
+                            rgb->data_w() / double(Wfull), rgb->data_h() / double(Hfull),
+                            Xs + this->floor(offset_x_), Ys + this->floor(offset_y_),
+                            Wfull, Hfull);
   if (need_clip) pop_clip();
 }
 
@@ -822,13 +1155,25 @@ int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int de
   memset(&srcattr, 0, sizeof(XRenderPictureAttributes));
   static XRenderPictFormat *fmt24 = XRenderFindStandardFormat(fl_display, PictStandardRGB24);
   static XRenderPictFormat *fmt32 = XRenderFindStandardFormat(fl_display, PictStandardARGB32);
-  static XRenderPictFormat *dstfmt = XRenderFindVisualFormat(fl_display, fl_visual->visual);
   srcattr.repeat = RepeatPad;
   Picture src = XRenderCreatePicture(fl_display, (Pixmap)pixmap, has_alpha ?fmt32:fmt24,
                                      CPRepeat, &srcattr);
+  fl_uintptr_t scaled = 0;
+  int ok = render_picture(src, has_alpha, scale_x, scale_y, XP, YP, WP, HP, scaled);
+  if (src) XRenderFreePicture(fl_display, src);
+  return ok;
+}
+
+/* Composites the Picture src onto the current drawable, scale_x and scale_y being
+ source pixels per drawn pixel. XP,YP,WP,HP are in drawing units. The transform stays set on src; scaled tells
+ whether src may have one other than identity, so that it is only reset when needed.
+ */
+int Fl_Xlib_Graphics_Driver::render_picture(fl_uintptr_t src, bool has_alpha, double scale_x, double scale_y,
+                                            int XP, int YP, int WP, int HP, fl_uintptr_t &scaled) {
+  static XRenderPictFormat *dstfmt = XRenderFindVisualFormat(fl_display, fl_visual->visual);
   Picture dst = XRenderCreatePicture(fl_display, fl_window, dstfmt, 0, 0);
   if (!src || !dst) {
-    fprintf(stderr, "Failed to create Render pictures (%lu %lu)\n", src, dst);
+    fprintf(stderr, "Failed to create Render pictures (%lu %lu)\n", (unsigned long)src, dst);
     return 0;
   }
   Fl_Region r = scale_clip(scale());
@@ -836,14 +1181,15 @@ int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int de
   if (clipr)
     XRenderSetPictureClipRegion(fl_display, dst, clipr);
   unscale_clip(r);
-  if (scale_x != 1 || scale_y != 1) {
+  if (scale_x != 1 || scale_y != 1 || scaled) {
     XTransform mat = {{
       { XDoubleToFixed( scale_x ), XDoubleToFixed( 0 ),       XDoubleToFixed( 0 ) },
       { XDoubleToFixed( 0 ),       XDoubleToFixed( scale_y ), XDoubleToFixed( 0 ) },
       { XDoubleToFixed( 0 ),       XDoubleToFixed( 0 ),       XDoubleToFixed( 1 ) }
     }};
     XRenderSetPictureTransform(fl_display, src, &mat);
-    if (Fl_Image::scaling_algorithm() == FL_RGB_SCALING_BILINEAR) {
+    scaled = (scale_x != 1 || scale_y != 1);
+    if (scaled && Fl_Image::scaling_algorithm() == FL_RGB_SCALING_BILINEAR) {
       XRenderSetPictureFilter(fl_display, src, FilterBilinear, 0, 0);
       // A note at  https://www.talisman.org/~erlkonig/misc/x11-composite-tutorial/ :
       // "When you use a filter you'll probably want to use PictOpOver as the render op,
@@ -851,20 +1197,28 @@ int Fl_Xlib_Graphics_Driver::scale_and_render_pixmap(Fl_Offscreen pixmap, int de
       // the edges may end up having alpha values after the filter has been applied."
       // suggests this is necessary :
       has_alpha = true;
+    } else {
+      XRenderSetPictureFilter(fl_display, src, FilterNearest, 0, 0);
     }
   }
   XRenderComposite(fl_display, (has_alpha ? PictOpOver : PictOpSrc), src, None, dst, 0, 0, 0, 0,
                    XP, YP, WP, HP);
-  XRenderFreePicture(fl_display, src);
   XRenderFreePicture(fl_display, dst);
   return 1;
 }
 
 #endif // HAVE_XRENDER
 
-void Fl_Xlib_Graphics_Driver::uncache(Fl_RGB_Image*, fl_uintptr_t &id_, fl_uintptr_t &mask_)
+void Fl_Xlib_Graphics_Driver::uncache(Fl_RGB_Image *img, fl_uintptr_t &id_, fl_uintptr_t &mask_)
 {
   if (id_) {
+#if HAVE_XRENDER
+    if (img->d() == 2 || img->d() == 4) {
+      // see cache(): a Picture, mask_ tells whether it has a transform
+      XRenderFreePicture(fl_display, (Picture)id_);
+      mask_ = 0;
+    } else
+#endif
     XFreePixmap(fl_display, (Pixmap)id_);
     id_ = 0;
   }
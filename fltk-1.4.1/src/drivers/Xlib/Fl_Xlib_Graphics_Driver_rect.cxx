@@ -26,6 +26,7 @@
 #include <FL/platform.H>
 
 #include "Fl_Xlib_Graphics_Driver.H"
+#include <stdlib.h>
 
 // Arbitrary line clipping: clip line end points to 16-bit coordinate range.
 
@@ -258,6 +259,64 @@ void Fl_Xlib_Graphics_Driver::line_unscaled(int x, int y, int x1, int y1, int x2
   }
 }
 
+// --- batched lines: scaled, offset and clipped in one pass, sent in one request
+
+// Returns room for n elements of the given size, growing one shared buffer.
+void *Fl_Xlib_Graphics_Driver::batch_buffer(int n, size_t size) {
+  size_t need = n * size;
+  if (need > batch_buffer_size_) {
+    batch_buffer_size_ = need > 2 * batch_buffer_size_ ? need : 2 * batch_buffer_size_;
+    batch_buffer_ = realloc(batch_buffer_, batch_buffer_size_);
+  }
+  return batch_buffer_;
+}
+
+void Fl_Xlib_Graphics_Driver::segments(int n, const int *xy) {
+  if (n <= 0) return;
+  // fl_line() draws horizontal and vertical lines with xyline() and yxline(),
+  // which place them differently when scaled or wider than 1 pixel: draw
+  // those the same way so that both give the same pixels
+  bool rectilinear = (scale() != 1 || line_width_ >= 2);
+  int x_offset = floor(offset_x_);
+  int y_offset = floor(offset_y_);
+  XSegment *s = (XSegment*)batch_buffer(n, sizeof(XSegment));
+  int m = 0;
+  for (int i = 0; i < n; i++, xy += 4) {
+    if (xy[1] == xy[3] || xy[0] == xy[2]) {
+      if (rectilinear) {
+        line(xy[0], xy[1], xy[2], xy[3]);
+        continue;
+      }
+      // and like them, skip horizontal lines above / vertical lines left of 0
+      if (xy[1] == xy[3] ? xy[1] < 0 : xy[0] < 0) continue;
+    }
+    int x1 = floor(xy[0]) + x_offset, y1 = floor(xy[1]) + y_offset;
+    int x2 = floor(xy[2]) + x_offset, y2 = floor(xy[3]) + y_offset;
+    if (clip_line(x1, y1, x2, y2)) continue;
+    s[m].x1 = x1; s[m].y1 = y1;
+    s[m].x2 = x2; s[m].y2 = y2;
+    m++;
+  }
+  if (m) XDrawSegments(fl_display, fl_window, gc_, s, m);
+}
+
+void Fl_Xlib_Graphics_Driver::polyline(int n, const int *xy) {
+  if (n < 2) return;
+  int x_offset = floor(offset_x_);
+  int y_offset = floor(offset_y_);
+  XPoint *p = (XPoint*)batch_buffer(n, sizeof(XPoint));
+  for (int i = 0; i < n; i++) {
+    int x = floor(xy[2*i]) + x_offset, y = floor(xy[2*i+1]) + y_offset;
+    if (x != clip_xy(x) || y != clip_xy(y)) {
+      // outside the 16-bit coordinate space: clip segment by segment
+      Fl_Graphics_Driver::polyline(n, xy);
+      return;
+    }
+    p[i].x = x; p[i].y = y;
+  }
+  XDrawLines(fl_display, fl_window, gc_, p, n, 0);
+}
+
 void Fl_Xlib_Graphics_Driver::xyline_unscaled(int x, int y, int x1) {
   if (line_width_ >= 2) x1++;
   x += floor(offset_x_) ;
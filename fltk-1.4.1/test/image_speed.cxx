@@ -0,0 +1,120 @@
+//
+// fl_draw_image() speed test for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2025 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     https://www.fltk.org/COPYING.php
+//
+// Please see the following page on how to report bugs and issues:
+//
+//     https://www.fltk.org/bugs.php
+//
+
+// Draws frames of every image layout fl_draw_image() takes and prints how
+// long each frame took. Under X11 the pixels are converted to the layout of
+// the visual first, so run it once per visual (see list_visuals) to cover
+// every depth, e.g. on Xvfb screens of depth 8, 16 and 24.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Window.H>
+#include <FL/platform.H>
+#include <FL/fl_draw.H>
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "list_visuals.cxx"
+
+const int width = 640;
+const int height = 480;
+const int frames = 100;
+uchar *image;
+
+void make_image() {
+  image = new uchar[4*width*height];
+  uchar *p = image;
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width; x++) {
+      *p++ = uchar(x);
+      *p++ = uchar(y);
+      *p++ = uchar(x+y);
+      *p++ = uchar(x^y);
+    }
+}
+
+void line_cb(void *, int x, int y, int w, uchar *buf) {
+  memcpy(buf, image+3*(y*width+x), 3*w);
+}
+
+// Times frames of one layout; reading a pixel back waits until the
+// window system has drawn them.
+void run(Fl_Window *window, const char *name, const uchar *buf, int d, int l, bool mono) {
+  window->make_current();
+  uchar pixel[3];
+  Fl_Timestamp start = Fl::now();
+  for (int i = 0; i < frames; i++) {
+    if (!buf) fl_draw_image(line_cb, 0, 0, 0, width, height, d);
+    else if (mono) fl_draw_image_mono(buf, 0, 0, width, height, d, l);
+    else fl_draw_image(buf, 0, 0, width, height, d, l);
+  }
+  fl_read_image(pixel, 0, 0, 1, 1);
+  double ms = 1000 * Fl::seconds_since(start) / frames;
+  printf("%-24s %7.2f ms/frame %8.1f Mpixel/s\n", name, ms, width*height/ms/1000);
+}
+
+int main(int argc, char ** argv) {
+  int i = 1;
+  if (!Fl::args(argc,argv,i) || i < argc-1) {
+    printf("usage: %s <switches> visual-number\n"
+           " - : default visual\n"
+           " r : call Fl::visual(FL_RGB)\n",argv[0]);
+#ifdef FLTK_USE_X11
+    printf(" # : use this visual:\n");
+    list_visuals();
+#endif
+    puts(Fl::help);
+    exit(1);
+  }
+  if (i!=argc) {
+    if (argv[i][0] == 'r') {
+      if (!Fl::visual(FL_RGB)) printf("Fl::visual(FL_RGB) returned false.\n");
+    } else if (argv[i][0] != '-') {
+#ifdef FLTK_USE_X11
+      int visid = atoi(argv[i]);
+      fl_open_display();
+      XVisualInfo templt; int num;
+      templt.visualid = visid;
+      fl_visual = XGetVisualInfo(fl_display, VisualIDMask, &templt, &num);
+      if (!fl_visual) Fl::fatal("No visual with id %d",visid);
+      fl_colormap = XCreateColormap(fl_display, RootWindow(fl_display,fl_screen),
+                                    fl_visual->visual, AllocNone);
+      fl_xpixel(FL_BLACK); // make sure black is allocated
+#else
+      Fl::fatal("Visual id's not supported on Windows or MacOS.");
+#endif
+    }
+  }
+  make_image();
+  Fl_Window window(width, height, "fl_draw_image() speed");
+  window.end();
+  window.show(argc, argv);
+  while (!window.visible()) Fl::wait();
+  Fl::flush();
+
+#ifdef FLTK_USE_X11
+  if (fl_x11_display())
+    printf("visual 0x%lx, depth %d\n", (unsigned long)fl_visual->visualid, fl_visual->depth);
+#endif
+  printf("%d frames of %dx%d\n", frames, width, height);
+  run(&window, "RGB", image, 3, 0, false);
+  run(&window, "RGB, 4 bytes per pixel", image, 4, 0, false);
+  run(&window, "RGB, bottom to top", image+3*width*(height-1), 3, -3*width, false);
+  run(&window, "RGB from callback", 0, 3, 0, false);
+  run(&window, "gray", image, 1, 0, true);
+  run(&window, "gray, 4 bytes per pixel", image, 4, 0, true);
+  return 0;
+}
@@ -3,20 +3,16 @@ out vec4 FragColor;
 
 in vec3 ourColor;
 in vec2 TexCoord;
+flat in int Layer;
 
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+uniform sampler2DArray textures;
+uniform vec2 layerScale[16]; // UV scale of padded layers
 
 void main()
 {
-    vec4 tex1 = texture(texture1, TexCoord);
-    vec4 tex2 = texture(texture2, TexCoord);
-    
-    // Use TexCoord.x to split the triangle
-    // If x < 0.5, use first texture, else use second texture
-    if(TexCoord.x < 0.5) {
-        FragColor = tex1;  // Left half: first texture
-    } else {
-        FragColor = tex2;  // Right half: second texture
-    }
+    // Instances pick an array layer by index; without one (Layer < 0)
+    // use TexCoord.x to split the triangle:
+    // if x < 0.5, use the first layer, else use the second layer
+    int layer = Layer < 0 ? int(TexCoord.x >= 0.5) : Layer;
+    FragColor = texture(textures, vec3(TexCoord * layerScale[layer], layer));
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 400
+// One triangle covering the whole viewport, no vertex buffer needed:
+// vertices (-1,-1), (3,-1), (-1,3)
+out vec2 TexCoord;
+
+uniform vec2 uvScale; // part of the source the frame covers
+
+void main()
+{
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoord = p * uvScale;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#version 400
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D source;
+uniform vec2 texelSize;
+uniform vec2 uvMax; // last texel centre the frame covers
+
+const float SPAN_MAX = 8.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+
+vec3 fetch(vec2 uv)
+{
+    return texture(source, min(uv, uvMax)).rgb;
+}
+
+float luma(vec3 c)
+{
+    return dot(c, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    // FXAA (Lottes), the compact PC variant: blur along the edge direction
+    // estimated from the luma of the four diagonal neighbours
+    vec3 rgbM = fetch(TexCoord);
+    float lumaNW = luma(fetch(TexCoord + vec2(-1.0, -1.0) * texelSize));
+    float lumaNE = luma(fetch(TexCoord + vec2(1.0, -1.0) * texelSize));
+    float lumaSW = luma(fetch(TexCoord + vec2(-1.0, 1.0) * texelSize));
+    float lumaSE = luma(fetch(TexCoord + vec2(1.0, 1.0) * texelSize));
+    float lumaM = luma(rgbM);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0 / (min(abs(dir.x), abs(dir.y)) + reduce);
+    dir = clamp(dir * scale, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texelSize;
+
+    vec3 rgbA = 0.5 * (fetch(TexCoord + dir * (1.0 / 3.0 - 0.5)) +
+                       fetch(TexCoord + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (fetch(TexCoord + dir * -0.5) +
+                                     fetch(TexCoord + dir * 0.5));
+    float lumaB = luma(rgbB);
+    FragColor = vec4(lumaB < lumaMin || lumaB > lumaMax ? rgbA : rgbB, 1.0);
+}
\ No newline at end of file
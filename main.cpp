@@ -13,6 +13,24 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+#include "FrameStats.h"
+#include "Headless.h"
+#include "Mesh.h"
+#include "Mipmap.h"
+#include "Options.h"
+#include "PostProcess.h"
+#include "RenderQueue.h"
+#include "RingBuffer.h"
+#include "SceneGraph.h"
+#include "ShaderProgram.h"
+#include "ShaderReload.h"
+#include "TextureArray.h"
+#include "TextureLoader.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -32,9 +50,30 @@ std::string textFileRead(char *fn) {
 }
 
 
-GLuint shader_programme, vao;
+Options options;
+ProgramCache programCache;
+ShaderProgram program;
+ShaderReloader shaderReloader;
+GLuint vao;
 int height, width;
-glm::mat4 projection, view, model, mvp;
+glm::mat4 projection, view;
+
+// The "Frame" uniform block of vertex.vert (std140)
+struct FrameUniforms {
+    glm::mat4 mvp;
+};
+const GLuint FRAME_BLOCK = 0; // its binding point
+GLint uniformAlignment = 256;
+
+// Per-frame data (uniform block, instances) is written into a persistently
+// mapped ring buffer. The instance attributes of every VAO in instancedVaos
+// read from it, starting at instance 0 of the buffer; draws select their
+// instances with the base instance.
+RingBuffer ring;
+std::vector<GLuint> instancedVaos;
+GLuint instanceSource;          // buffer the instance attributes point at
+GLintptr lastInstances;         // last frame's instances in the ring
+size_t lastInstanceBytes;
 
 float vertices[] = {
     // positions          // colors           // texture coords
@@ -43,34 +82,254 @@ float vertices[] = {
      0.0f,  0.5f, 0.0f,  0.0f, 0.0f, 1.0f,  0.5f, 1.0f   // top
 };
 
-unsigned int texture1, texture2;
+// Texture array layers; at most 16, the size of layerScale in fragment.frag
+const std::vector<std::string> materialFiles = {"1.png", "2.png", "wall.jpg", "wall32.jpg", "wallg.jpg"};
+// Written by spg --cook, used instead of materialFiles while it is newer
+const char *cookedMaterials = "materials.stex";
 
-void display() {
+TextureLoader textures;
+TextureArray materials;
+
+// Optional imported model, drawn instead of the triangle
+Mesh mesh;
+
+// Every copy of the triangle (or mesh) is a node; each frame only the visible
+// ones end up in the instance buffer, grouped into one draw call per state.
+// The render queue animates and culls the next frame on other threads.
+SceneGraph scene;
+RenderQueue renderQueue;
+std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+// --animate spins each drawable node: local = base * rotation * fit
+struct Spinner {
+    int node;
+    glm::mat4 base;
+};
+std::vector<Spinner> spinners;
+glm::mat4 geometryFit(1.0f);
+
+// --post: the scene goes through an offscreen target and fullscreen passes
+PostProcess post;
+
+FrameStats stats;
+bool showOverlay;
+
+// Per-instance model matrix (locations 3-6, one per column) and layer (7)
+// of the currently bound VAO, starting at instance first of buffer
+void bindInstances(GLuint buffer, int first = 0) {
+    typedef SceneGraph::Instance Instance;
+    size_t base = (size_t)first * sizeof(Instance);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (int column = 0; column < 4; column++) {
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                              (void*)(base + offsetof(Instance, model) + column * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribDivisor(3 + column, 1);
+    }
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(base + offsetof(Instance, layer)));
+    glEnableVertexAttribArray(7);
+    glVertexAttribDivisor(7, 1);
+}
+
+// Draws one frame into the currently bound framebuffer
+void renderScene() {
+    // Stream a slice of any pending texture uploads
+    stats.begin("texture upload");
+    textures.update();
+    stats.end();
+
+    // Take the frame prepared (animated, culled, sorted) on the other
+    // threads, and have them start on the next one while this one is drawn
+    stats.begin("wait for prep");
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    RenderQueue::Frame &frame = renderQueue.acquire(projection * view, time);
+    renderQueue.kick(projection * view, time);
+    stats.end();
+
+    stats.begin("scene");
+    // This frame's section of the ring holds the uniform block and then the
+    // instances. Unchanged instances are not written again but copied
+    // forward from last frame's section on the GPU.
+    typedef SceneGraph::Instance Instance;
+    size_t instanceBytes = frame.upload ? frame.instances.size() * sizeof(Instance) : lastInstanceBytes;
+    ring.beginFrame(sizeof(FrameUniforms) + uniformAlignment + instanceBytes + sizeof(Instance));
+    if (ring.handle() != instanceSource) {
+        // The ring grew into a new buffer
+        for (GLuint instanced : instancedVaos) {
+            glBindVertexArray(instanced);
+            bindInstances(ring.handle());
+        }
+        instanceSource = ring.handle();
+    }
+
+    GLintptr uniformOffset = 0, instanceOffset = 0;
+    FrameUniforms *uniforms =
+        (FrameUniforms*)ring.allocate(sizeof(FrameUniforms), uniformAlignment, uniformOffset);
+    uniforms->mvp = frame.viewProjection;
+    void *instances = ring.allocate(instanceBytes, sizeof(Instance), instanceOffset);
+    if (frame.upload)
+        memcpy(instances, frame.instances.data(), instanceBytes);
+    ring.flush();
+    if (!frame.upload && instanceBytes) {
+        glBindBuffer(GL_COPY_READ_BUFFER, ring.handle());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ring.handle());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, lastInstances, instanceOffset,
+                            instanceBytes);
+        ring.read(lastInstances);
+    }
+    lastInstances = instanceOffset;
+    lastInstanceBytes = instanceBytes;
+    int baseInstance = (int)(instanceOffset / sizeof(Instance));
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_BLOCK, ring.handle(), uniformOffset, sizeof(FrameUniforms));
+    stats.stateChange();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glUseProgram(shader_programme);
 
-    // Update MVP matrix
-    model = glm::mat4(1.0f); // Identity matrix
-    mvp = projection * view * model;
+    // The commands only bind what changes between the sorted batches
+    for (const RenderQueue::Command &c : frame.commands) {
+        const SceneGraph::Drawable &d = c.state;
+        switch (c.op) {
+        case RenderQueue::USE_PROGRAM:
+            program.use();
+            stats.stateChange();
+            break;
+        case RenderQueue::BIND_MATERIAL:
+            // All materials live in one texture array
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, materials.texture(textures));
+            stats.stateChange();
+            break;
+        case RenderQueue::BIND_VERTEX_ARRAY:
+            glBindVertexArray(d.vao);
+            stats.stateChange();
+            break;
+        case RenderQueue::DRAW:
+            if (GLEW_ARB_base_instance) {
+                if (d.indexed)
+                    glDrawElementsInstancedBaseInstance(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, (void*)0,
+                                                        c.instanceCount, baseInstance + c.firstInstance);
+                else
+                    glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, d.count, c.instanceCount,
+                                                      baseInstance + c.firstInstance);
+            } else {
+                // Point the instance attributes at the batch instead
+                bindInstances(ring.handle(), baseInstance + c.firstInstance);
+                stats.stateChange();
+                if (d.indexed)
+                    glDrawElementsInstanced(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, (void*)0, c.instanceCount);
+                else
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, d.count, c.instanceCount);
+            }
+            stats.drawCall();
+            break;
+        }
+    }
+    ring.endFrame();
+    stats.end();
+}
 
-    // Set uniforms
-    GLuint matrixID = glGetUniformLocation(shader_programme, "MVP");
-    glUniformMatrix4fv(matrixID, 1, GL_FALSE, glm::value_ptr(mvp));
+// Draws one frame into output (0 = the window), through the post-process
+// chain if there is one
+void drawFrame(GLuint output) {
+    if (post.enabled()) {
+        post.begin();
+        renderScene();
+        stats.begin("post");
+        post.end(output);
+        stats.end();
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, output);
+        renderScene();
+    }
+}
 
-    // Bind textures
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glUniform1i(glGetUniformLocation(shader_programme, "texture1"), 0);
-    
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    glUniform1i(glGetUniformLocation(shader_programme, "texture2"), 1);
+// Frame statistics in the top left corner, drawn with the fixed pipeline
+void drawOverlay() {
+    glUseProgram(0);
+    glBindVertexArray(0);
+    glDisable(GL_DEPTH_TEST);
+    glColor3f(1.0f, 1.0f, 0.6f);
+
+    int y = glutGet(GLUT_WINDOW_HEIGHT) - 16;
+    for (const std::string &line : stats.overlay()) {
+        glWindowPos2i(8, y);
+        glutBitmapString(GLUT_BITMAP_8_BY_13, (const unsigned char*)line.c_str());
+        y -= 15;
+    }
+    glEnable(GL_DEPTH_TEST);
+}
 
-    // Draw triangle
-    glBindVertexArray(vao);
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+// Resolves the uniforms and sets the ones that never change; again after
+// every shader reload, since the new program starts with default values
+void setupProgram() {
+    program.bindBlock("Frame", FRAME_BLOCK);
+    program.use();
+    program.set("textures", 0);
+    program.set("layerScale", materials.layerScale());
+}
+
+void display() {
+    // Swap in a rebuilt program, between two frames
+    if (GLuint rebuilt = shaderReloader.poll()) {
+        program.adopt(rebuilt);
+        setupProgram();
+    }
 
+    stats.beginFrame();
+    drawFrame(0);
+    if (showOverlay)
+        drawOverlay();
+
+    stats.begin("swap");
     glutSwapBuffers();
+    stats.end();
+    stats.endFrame();
+
+    // Keep redrawing until every texture has been uploaded, or continuously
+    // while the overlay is shown or the scene is animated
+    if (!textures.pending() && !showOverlay && !options.animate)
+        glutIdleFunc(NULL);
+}
+
+void idle() {
+    glutPostRedisplay();
+}
+
+// Redraws when the shader watcher has a new program
+void checkShaders(int) {
+    if (shaderReloader.pending())
+        glutPostRedisplay();
+    glutTimerFunc(100, checkShaders, 0);
+}
+
+void writeTrace() {
+    std::string path = options.trace.empty() ? "trace.json" : options.trace;
+    if (stats.writeTrace(path))
+        std::cout << "Trace written to " << path << std::endl;
+    else
+        std::cout << "Failed to write " << path << std::endl;
+}
+
+void keyboard(unsigned char key, int, int) {
+    switch (key) {
+    case 'o': // toggle the statistics overlay
+        showOverlay = !showOverlay;
+        glutIdleFunc(idle);
+        break;
+    case 't': // dump a Chrome trace of the frames so far
+        writeTrace();
+        break;
+    }
+}
+
+// The window is closing while its context is still current
+void windowClosed() {
+    // A frame is always in flight and may still be animating nodes through
+    // spinners and geometryFit; stop before any of them go away
+    renderQueue.stop();
+    shaderReloader.stop();
+    if (!options.trace.empty())
+        writeTrace();
 }
 
 void init() {
@@ -87,20 +346,54 @@ void init() {
 }
 
 void reshape(int w, int h) {
+    width = w;
+    height = h;
     glViewport(0, 0, w, h);
+    post.resize(w, h);
     float aspect = (float)w / (float)h;
     projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
 }
 
-int main(int argc, char** argv) {
-    glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
-    glutInitWindowSize(800, 600);
-    glutInitWindowPosition(100, 100);
-    glutCreateWindow("Texture Demo");
+// A single untransformed triangle (or mesh), or a grid of count small
+// rotated copies cycling through the texture layers, one group node per row.
+// fit maps the geometry, spanning [lo, hi], onto the triangle's size.
+void buildScene(int count, int layers, const SceneGraph::Drawable &d, const glm::vec3 &lo, const glm::vec3 &hi,
+                const glm::mat4 &fit) {
+    geometryFit = fit;
+    int root = scene.addGroup(-1, glm::mat4(1.0f));
+    if (count == 1) {
+        spinners.push_back({scene.addDrawable(root, fit, d, lo, hi, -1.0f), glm::mat4(1.0f)});
+        return;
+    }
 
-    glewInit();
+    int columns = (int)std::ceil(std::sqrt((float)count));
+    int rows = (count + columns - 1) / columns;
+    float cell = std::min(3.0f / columns, 2.2f / rows);
+    int row = -1;
+    for (int i = 0; i < count; i++) {
+        if (i % columns == 0) {
+            float y = (i / columns - (rows - 1) / 2.0f) * cell;
+            row = scene.addGroup(root, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, y, 0.0f)));
+        }
+        float x = (i % columns - (columns - 1) / 2.0f) * cell;
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, 0.0f));
+        m = glm::rotate(m, i * 0.7f, glm::vec3(0.0f, 0.0f, 1.0f));
+        m = glm::scale(m, glm::vec3(cell * 0.9f));
+        spinners.push_back({scene.addDrawable(row, m * fit, d, lo, hi, (float)(i % layers)), m});
+    }
+}
 
+// Runs on the render queue's threads
+void spin(size_t begin, size_t end, double time) {
+    for (size_t i = begin; i < end; i++) {
+        float angle = (float)time * (0.5f + (i % 7) * 0.25f);
+        glm::mat4 r = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 0.0f, 1.0f));
+        scene.setLocal(spinners[i].node, spinners[i].base * r * geometryFit);
+    }
+}
+
+// Creates the GL objects of the scene; needs a current context
+void setupScene() {
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
 
@@ -121,82 +414,251 @@ int main(int argc, char** argv) {
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
     glEnableVertexAttribArray(2);
 
+    // Per-frame data, sized for every instance being visible
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    ring.init(sizeof(FrameUniforms) + uniformAlignment + (options.instances + 1) * sizeof(SceneGraph::Instance));
+    instanceSource = ring.handle();
+    bindInstances(instanceSource);
+    instancedVaos.push_back(vao);
+
+    SceneGraph::Drawable geometry = {0, 0, vao, 3, false};
+    glm::vec3 lo(-0.5f, -0.5f, 0.0f), hi(0.5f, 0.5f, 0.0f);
+    glm::mat4 fit(1.0f);
+    if (!options.mesh.empty() && mesh.load(options.mesh)) {
+        bindInstances(instanceSource);
+        instancedVaos.push_back(mesh.vertexArray());
+        geometry = {0, 0, mesh.vertexArray(), mesh.indexCount(), true};
+        lo = glm::vec3(mesh.boundsMin()[0], mesh.boundsMin()[1], mesh.boundsMin()[2]);
+        hi = glm::vec3(mesh.boundsMax()[0], mesh.boundsMax()[1], mesh.boundsMax()[2]);
+        // Centre the mesh and scale it to the triangle's size
+        float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+        fit = glm::scale(glm::mat4(1.0f), glm::vec3(extent > 0 ? 1.0f / extent : 1.0f));
+        fit = glm::translate(fit, -(lo + hi) * 0.5f);
+    }
+    glBindVertexArray(0);
+    buildScene(options.instances, (int)materialFiles.size(), geometry, lo, hi, fit);
+    if (options.animate)
+        renderQueue.setAnimation(spinners.size(), spin);
+    renderQueue.start(scene, options.threads);
+
     // Load and create textures
     stbi_set_flip_vertically_on_load(true);
 
-    // Load first texture
-    glGenTextures(1, &texture1);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int width, height, nrChannels;
-    unsigned char *data = stbi_load("1.png", &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture 1" << std::endl;
-    }
-    stbi_image_free(data);
-
-    // Load second texture
-    glGenTextures(1, &texture2);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    data = stbi_load("2.png", &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture 2" << std::endl;
-    }
-    stbi_image_free(data);
+    // Decode on worker threads, upload over the next frames
+    textures.start();
+    materials.create(textures, materialFiles, cookedMaterials);
 
     // Create and compile shaders
     std::string vstext = textFileRead("vertex.vert");
     std::string fstext = textFileRead("fragment.frag");
-    const char* vertex_shader = vstext.c_str();
-    const char* fragment_shader = fstext.c_str();
+    programCache.init();
+    program.build(vstext, fstext, &programCache);
+    if (!options.post.empty())
+        post.create(options.post, &programCache);
+
+    // Resolve uniforms and bind the samplers to their texture units once
+    setupProgram();
+
+    stats.init();
+    init();
+}
+
+void printStats(const char *label, std::vector<double> ms) {
+    std::sort(ms.begin(), ms.end());
+    double sum = 0;
+    for (double v : ms)
+        sum += v;
+    printf("%s ms: min %.3f  avg %.3f  p99 %.3f  max %.3f\n", label, ms.front(), sum / ms.size(),
+           ms[std::min(ms.size() - 1, ms.size() * 99 / 100)], ms.back());
+}
 
-    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vs, 1, &vertex_shader, NULL);
-    glCompileShader(vs);
+// Renders options.frames frames into an offscreen framebuffer and reports
+// CPU submission time, GPU time (GL_TIME_ELAPSED) and throughput.
+int benchmark(const Options &options) {
+    HeadlessContext context;
+    if (!context.create(options.width, options.height))
+        return 1;
+    printf("Renderer: %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    setupScene();
+    reshape(options.width, options.height);
+
+    // Finish the texture uploads first so every timed frame draws the same
+    // thing, and render one untimed frame so shader compilation done lazily
+    // by the driver does not land in the first sample
+    while (textures.pending())
+        textures.update();
+    drawFrame(context.framebuffer());
+    glFinish();
+
+    int frames = options.frames;
+    std::vector<GLuint> queries(frames);
+    std::vector<double> cpuMs(frames), gpuMs(frames);
+    glGenQueries(frames, queries.data());
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        auto frameStart = std::chrono::steady_clock::now();
+        stats.beginFrame();
+        glBeginQuery(GL_TIME_ELAPSED, queries[i]);
+        drawFrame(context.framebuffer());
+        glEndQuery(GL_TIME_ELAPSED);
+        stats.endFrame();
+        cpuMs[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    }
+    glFinish();
+    double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fs, 1, &fragment_shader, NULL);
-    glCompileShader(fs);
+    for (int i = 0; i < frames; i++) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &ns);
+        gpuMs[i] = ns / 1e6;
+    }
+    glDeleteQueries(frames, queries.data());
+
+    printf("%d frames at %dx%d\n", frames, options.width, options.height);
+    printStats("cpu", cpuMs);
+    printStats("gpu", gpuMs);
+    printf("throughput: %.1f frames/s\n", frames / totalSeconds);
+    printf("per frame: %d draw calls, %d state changes, %d preparation threads\n", stats.lastFrameDrawCalls(),
+           stats.lastFrameStateChanges(), renderQueue.threads());
+    renderQueue.stop();
+
+    if (!options.csv.empty()) {
+        std::ofstream csv(options.csv);
+        csv << "frame,cpu_ms,gpu_ms\n";
+        for (int i = 0; i < frames; i++)
+            csv << i << "," << cpuMs[i] << "," << gpuMs[i] << "\n";
+    }
+    if (!options.trace.empty())
+        writeTrace();
+    if (!options.png.empty() && !context.savePng(options.png)) {
+        std::cout << "Failed to write " << options.png << std::endl;
+        return 1;
+    }
+    return 0;
+}
 
-    shader_programme = glCreateProgram();
-    glAttachShader(shader_programme, vs);
-    glAttachShader(shader_programme, fs);
-    glLinkProgram(shader_programme);
+// Times the CPU mip chain (every kernel, one thread and all of them) and
+// glGenerateMipmap on the same image, both with and without the upload.
+int benchmarkMipmaps(const Options &options) {
+    HeadlessContext context;
+    if (!context.create(64, 64))
+        return 1;
+    printf("Renderer: %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+    int w = 4096, h = 4096, nrChannels;
+    std::vector<unsigned char> image;
+    if (!options.mipImage.empty()) {
+        unsigned char *data = stbi_load(options.mipImage.c_str(), &w, &h, &nrChannels, 4);
+        if (!data) {
+            std::cout << "Failed to load " << options.mipImage << std::endl;
+            return 1;
+        }
+        image.assign(data, data + (size_t)w * h * 4);
+        stbi_image_free(data);
+    } else {
+        // Fine stripes over a gradient, so averaging in the wrong space shows
+        image.resize((size_t)w * h * 4);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++) {
+                unsigned char *p = &image[((size_t)y * w + x) * 4];
+                p[0] = (x ^ y) & 1 ? 255 : 0;
+                p[1] = (unsigned char)(x * 255 / w);
+                p[2] = (unsigned char)(y * 255 / h);
+                p[3] = 255;
+            }
+    }
+    int levels = Mipmap::levelCount(w, h);
+    printf("%dx%d, %d levels\n", w, h, levels);
+
+    const int runs = 5;
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    Mipmap mips;
+    for (int k = Mipmap::SCALAR; k <= Mipmap::bestKernel(); k++)
+        for (int threads : {1, cores}) {
+            std::vector<double> ms;
+            for (int i = 0; i < runs; i++) {
+                auto start = std::chrono::steady_clock::now();
+                mips.build(image.data(), w, h, true, threads, (Mipmap::Kernel)k);
+                ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            std::string label = std::string("cpu ") + Mipmap::kernelName((Mipmap::Kernel)k) + " x" +
+                                std::to_string(threads);
+            printStats(label.c_str(), ms);
+            if (cores == 1)
+                break;
+        }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, w, h);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    std::vector<double> generateMs, gpuPathMs, cpuPathMs;
+    for (int i = 0; i < runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+        glFinish();
+        auto uploaded = std::chrono::steady_clock::now();
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        auto end = std::chrono::steady_clock::now();
+        generateMs.push_back(std::chrono::duration<double, std::milli>(end - uploaded).count());
+        gpuPathMs.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+        start = std::chrono::steady_clock::now();
+        mips.build(image.data(), w, h);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+        for (int l = 1; l < mips.count(); l++)
+            glTexSubImage2D(GL_TEXTURE_2D, l, 0, 0, mips.level(l).width, mips.level(l).height, GL_RGBA,
+                            GL_UNSIGNED_BYTE, mips.data(l));
+        glFinish();
+        cpuPathMs.push_back(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    glDeleteTextures(1, &texture);
+    printStats("glGenerateMipmap", generateMs);
+    printStats("upload + glGenerateMipmap", gpuPathMs);
+    printStats("cpu chain + upload of every level", cpuPathMs);
+    return 0;
+}
 
-    // Check for shader compilation errors
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vs, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vs, 512, NULL, infoLog);
-        std::cout << "Vertex shader compilation failed:\n" << infoLog << std::endl;
+int main(int argc, char** argv) {
+    if (!options.parse(argc, argv)) {
+        Options::usage();
+        return 1;
     }
-    glGetShaderiv(fs, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fs, 512, NULL, infoLog);
-        std::cout << "Fragment shader compilation failed:\n" << infoLog << std::endl;
+    if (options.cook) {
+        stbi_set_flip_vertically_on_load(true);
+        return CookedTexture::cook(materialFiles, cookedMaterials, options.cookCompressed) ? 0 : 1;
     }
+    if (!options.importSource.empty())
+        return Mesh::import(options.importSource, options.importDestination) ? 0 : 1;
+    if (options.benchMips)
+        return benchmarkMipmaps(options);
+    if (options.frames > 0)
+        return benchmark(options);
+
+    // The shader watcher builds programs on its own thread and GLX context
+    XInitThreads();
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(800, 600);
+    glutInitWindowPosition(100, 100);
+    glutCreateWindow("Texture Demo");
 
-    init();
+    glewInit();
+
+    setupScene();
+    if (shaderReloader.start("vertex.vert", "fragment.frag"))
+        glutTimerFunc(100, checkShaders, 0);
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
+    glutKeyboardFunc(keyboard);
+    glutCloseFunc(windowClosed);
+    glutIdleFunc(idle);
+    showOverlay = options.overlay;
     glutMainLoop();
 
     return 0;
@@ -0,0 +1,15 @@
+#version 400
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D source;
+uniform float exposure;
+
+void main()
+{
+    // Filmic curve (Narkowicz's fit of ACES), from HDR to [0, 1]
+    vec3 x = texture(source, TexCoord).rgb * exposure;
+    vec3 mapped = clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+    FragColor = vec4(mapped, 1.0);
+}
\ No newline at end of file
@@ -2,15 +2,23 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in mat4 aModel; // per instance, locations 3-6
+layout (location = 7) in float aLayer; // per instance
 
 out vec3 ourColor;
 out vec2 TexCoord;
+flat out int Layer;
 
-uniform mat4 MVP;
+// Per-frame values, streamed through a ring buffer (binding 0)
+layout (std140) uniform Frame
+{
+    mat4 MVP;
+};
 
 void main()
 {
-    gl_Position = MVP * vec4(aPos, 1.0);
+    gl_Position = MVP * aModel * vec4(aPos, 1.0);
     ourColor = aColor;
     TexCoord = aTexCoord;
+    Layer = int(aLayer);
 }
\ No newline at end of file